@@ -26,40 +26,90 @@ DEALINGS IN THE SOFTWARE.
 */
 
 #include <algorithm>
+#include <chrono>
 #include <format>
 #include <fstream>
 #include <iostream>
-#include <variant>
+#include <optional>
+#include <sstream>
 #include <vector>
 
 #include <boost/json.hpp>
 #include <nanodbc/nanodbc.h>
 
+#include "BinarySnapshot.h"
+#include "CmdLine.h"
+#include "CodePage.h"
+#include "Delta.h"
+#include "Columnar.h"
+#include "ConnectionPool.h"
+#include "ExportPipeline.h"
+#include "Extract.h"
+#include "LongData.h"
+#include "MemoryStats.h"
+#include "OrderedOutput.h"
+#include "Parallel.h"
 #include "Platform.h"
 #include "PrettyPrint.h"
-
-
-// json uses utf8, database has a mixture of wide, utf8 and code page string
-// for now this code assume string in db is CP1252, but this is only for MsAccess
-
-
-#include "utf8Conversion.h"
+#include "RowDecoder.h"
+#include "Snapshot.h"
 
 namespace json = boost::json;
 
+struct ExportOptions
+{
+   std::string     connection;                         // odbc connection string
+   bool            stream {};                          // write rows as they are fetched
+   long            rowsetSize {default_rowset_size};   // rows per SQLFetchScroll
+   bool            timing {};                          // report time spent per table on std::cerr
+   size_t          workers {1};                        // tables exported concurrently
+   size_t          partitions {1};                     // key ranges a table is split into
+   size_t          partitionWorkers {1};               // connections reading the partitions of a table, its share of workers
+   bool            columns {};                         // structure of array layout
+   bool            encode {};                          // delta-rle integer columns in columns layout
+   bool            binary {};                          // binary snapshot instead of json
+   bool            ndjson {};                          // a table line then a line per row instead of json
+   std::string     deltaFrom;                          // previous snapshot, export only the rows changed since
+   bool            arena {true};                       // json values allocated from monotonic arenas
+   bool            pipeline {};                        // fetch, convert and write rows on three threads
+   bool            longData {};                        // memo and blob columns streamed in chunks
+   BlobFormat      blobs {BlobFormat::Array};          // base64 with longData
+   PipelineOptions pipelineSizes;                      // batches and queues of the pipeline
+   const CodePage* codePage {&CodePage::Cp1252()};     // of the database narrow strings
+};
+
 struct TableExport
 {
    std::string name;
-   std::string extractQry;
+   std::string orderBy;   // its leading column is the partition key
+
+   std::string ExtractQry(const std::string& filter = {}) const
+   {
+      if (filter.empty())
+         return std::format("SELECT * FROM {} ORDER BY {}", name, orderBy);
+      return std::format("SELECT * FROM {} WHERE {} ORDER BY {}", name, filter, orderBy);
+   }
+
+   std::string PartitionKey() const { return orderBy.substr(0, orderBy.find(',')); }
+
+   std::vector<std::string> KeyColumns() const
+   {
+      std::vector<std::string> keys;
+      std::istringstream       columns(orderBy);
+      for (std::string column; std::getline(columns >> std::ws, column, ',');)
+         keys.push_back(column);
+      return keys;
+   }
 };
 
+// a table after the ones it references, so that JSon2Access can import it as it is streamed
 std::vector<TableExport> g_tablesToExport =
    {
-      {"Tags", "SELECT * FROM Tags ORDER BY Tag_Code"},
-      {"Fields", "SELECT * FROM Fields ORDER BY Msg_Code, Tag_Code"},
-      {"LogFiles", "SELECT * FROM LogFiles ORDER BY Log_Code"},
-      {"Messages", "SELECT * FROM Messages ORDER BY Msg_Code"},
-      {"LoggerMessages", "SELECT * FROM LoggerMessages ORDER BY Schema, Log_Code, Msg_Code"},
+      {"Tags", "Tag_Code"},
+      {"Messages", "Msg_Code"},
+      {"Fields", "Msg_Code, Tag_Code"},
+      {"LogFiles", "Log_Code"},
+      {"LoggerMessages", "Schema, Log_Code, Msg_Code"},
 };
 
 // dumping row to std::cerr for debugging purposes!
@@ -76,253 +126,687 @@ void DumpResult(nanodbc::result& result, short BadCol)
    std::cerr << "\n error with: " << result.column_name(BadCol) << std::endl;
 }
 
-struct ToJsonValue
+// could be used for a smaller output
+// at the expanse of readability & having to reconstruct objects
+// integer columns can be delta-rle encoded, see Columnar.h
+json::object GetStructureOfArray(nanodbc::result rowIt, const CodePage& codePage, BlobFormat blobs, bool encode, json::storage_ptr sp)
 {
-   json::value& _v;
-
-   ToJsonValue(json::value& v) :
-      _v(v) {}
-   void operator()(void*) const { _v = nullptr; }
-   void operator()(int64_t i) const { _v = i; }
-   void operator()(double d) const { _v = d; }
-   void operator()(const std::string& s) const { _v = s; }
-   void operator()(const std::vector<uint8_t>& v) const { _v = json::value_from(v); }
-};
+   RowDecoder               decoder(rowIt, codePage, blobs);
+   std::vector<json::array> columns;
+   json::value              jsonValue(sp);
+   size_t                   rowCount {0};
 
-struct ToJsonArray
-{
-   json::array& _a;
+   columns.reserve(decoder.Columns());
+   for (short colIdx = 0; colIdx < decoder.Columns(); colIdx++)
+      columns.emplace_back(sp);
 
-   ToJsonArray(json::array& a) :
-      _a(a) {}
-   void operator()(void*) const { _a.push_back(nullptr); }
-   void operator()(int64_t i) const { _a.push_back(i); }
-   void operator()(double d) const { _a.push_back(d); }
-   void operator()(const std::string& s) const
+   while (rowIt.next())
    {
-      json::value v;
+      rowCount++;
 
-      v = s;
-      _a.push_back(v);
+      for (short colIdx = 0; colIdx < decoder.Columns(); colIdx++)
+      {
+         decoder.DecodeColumn(rowIt, colIdx, jsonValue);
+         columns[colIdx].push_back(std::move(jsonValue));
+      }
    }
-   void operator()(const std::vector<uint8_t>& v) const
+
+   json::object data(sp);
+   for (short colIdx = 0; colIdx < decoder.Columns(); colIdx++)
    {
-      _a.push_back(json::value_from(v));
+      if (encode)
+         data[decoder.Key(colIdx)] = EncodeColumn(std::move(columns[colIdx]));
+      else
+         data[decoder.Key(colIdx)] = std::move(columns[colIdx]);
    }
-};
 
-using DbValue = std::variant<void*, int64_t, std::string, double, std::vector<uint8_t>>;
+   json::object object(sp);
+   object["recordCount"] = rowCount;
+   object["data"]        = std::move(data);
+
+   return object;
+}
+
+json::array GetArrayOfStructure(nanodbc::result rowIt, const CodePage& codePage, BlobFormat blobs, json::storage_ptr sp = {})
+{
+   RowDecoder  decoder(rowIt, codePage, blobs);
+   json::array rows(sp);
+   while (rowIt.next())
+   {
+      rows.push_back(decoder.DecodeRow(rowIt, sp));
+   }
+   return rows;
+}
 
-DbValue GetColumnValue(nanodbc::result& row, short col)
+// report on std::cerr, std::cout might be the exported document
+class TableTimer
 {
-   // for string conversion, msaccess uses:
-   // HKEY_LOCAL_MACHINE\SYSTEM\CurrentControlSet\Control\Nls\CodePage
-   // which in tmx case is codepage 1252
+   const ExportOptions&                  m_Options;
+   const std::string&                    m_Name;
+   std::chrono::steady_clock::time_point m_Start {std::chrono::steady_clock::now()};
 
-   // only when the row is bound can we test for NULL!
-   if (row.is_bound(col) && row.is_null(col))
-      return DbValue {};
+public:
+   TableTimer(const ExportOptions& options, const std::string& name) :
+      m_Options(options), m_Name(name) {}
 
-   // for long data type, must fetch then test for NULL
-   // for short data type, we must test for null before fetching!
-   switch (row.column_datatype(col))
+   void Done(size_t rowCount) const
    {
-      case SQL_LONGVARBINARY:
-      {
-         // Unbound data can only be tested for null once fetched
-         auto blob = row.get<std::vector<uint8_t>>(col);   // try to fetch blob
-         if (row.is_null(col) == false)                    // did we get data ?
-         {
-            return blob;
-         }
-         return DbValue {};
-      }
+      if (!m_Options.timing)
+         return;
+      auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - m_Start);
+      std::cerr << std::format("{}: {} row(s) in {} ms", m_Name, rowCount, elapsed.count()) << std::endl;
+   }
 
-      // for MsAccess, SQL_CHAR is CP1252,
-      // Json is utf8 !!
-      // now c++20 has support fo u8string (utf8) but not nanodbc or boost json!!!
-      // so here we do a conversion dance
-      case SQL_VARCHAR:
-      case SQL_CHAR:
-      {
-         return from_u8string(Cp1252ToUtf8(row.get<nanodbc::string>(col)));
-      }
+   void Stalls(const PipelineStalls& stalls) const
+   {
+      if (!m_Options.timing)
+         return;
+      auto ms = [](std::chrono::nanoseconds ns)
+      { return std::chrono::duration_cast<std::chrono::milliseconds>(ns).count(); };
+      std::cerr << std::format("{}: stalled fetch {} ms on output, convert {} ms on input, {} ms on output, write {} ms on input",
+                               m_Name, ms(stalls.fetchBlocked), ms(stalls.convertStarved), ms(stalls.convertBlocked), ms(stalls.writeStarved))
+                << std::endl;
+   }
+};
 
-      case SQL_LONGVARCHAR:
-      {
-         auto varchar = row.get<nanodbc::string>(col);
+// scratch memory for the rows of the streaming paths: rows are decoded in a stack buffer
+// and the arena is released every few rows instead of freeing each value
+class RowArena
+{
+   static constexpr size_t release_every = 256;
 
-         // only is it's not NULL can we use it, without the test the NULL column
-         // would be converted to empty string!!!
-         if (row.is_null(col) == false)
-         {
-            return from_u8string(Cp1252ToUtf8(varchar));
-         }
-         return DbValue {};
-      }
+   unsigned char            m_Buffer[64 * 1024];
+   json::monotonic_resource m_Resource {m_Buffer, sizeof(m_Buffer)};
+   bool                     m_Enabled;
+   size_t                   m_Rows {};
 
-      // we have unicode!
-      case SQL_WCHAR:
-      case SQL_WVARCHAR:
-         return from_u8string(WStringToUtf8(row.get<nanodbc::wide_string>(col)));
+public:
+   explicit RowArena(const ExportOptions& options) :
+      m_Enabled(options.arena) {}
 
-      case SQL_WLONGVARCHAR:
-      {
-         auto longVarChar = row.get<nanodbc::wide_string>(col);
-         if (row.is_null(col) == false)
-            return from_u8string(WStringToUtf8(longVarChar));
-         return DbValue {};
-      }
+   json::storage_ptr Storage() { return m_Enabled ? json::storage_ptr(&m_Resource) : json::storage_ptr {}; }
+
+   // once the row is written, nothing allocated from Storage() must still be alive
+   void RowDone()
+   {
+      if (m_Enabled && ++m_Rows % release_every == 0)
+         m_Resource.release();
+   }
+};
+
+// a whole table DOM lives in one arena, freed with the table
+json::storage_ptr TableStorage(const ExportOptions& options)
+{
+   if (!options.arena)
+      return {};
+   return json::make_shared_resource<json::monotonic_resource>();
+}
 
+// split the table on its partition key into contiguous ranges, in key order.
+// msaccess sorts NULL first, so they get the first partition.
+// concatenating the partitions gives the same order as the unfiltered query.
+// an empty result means the table is not partitioned: key is not an integer, table empty, ...
+std::vector<std::string> PartitionFilters(nanodbc::connection& conn, const TableExport& tableInfo, size_t partitions)
+{
+   if (partitions < 2)
+      return {};
+
+   auto key    = tableInfo.PartitionKey();
+   auto bounds = nanodbc::execute(conn, std::format("SELECT MIN({0}), MAX({0}) FROM {1}", key, tableInfo.name));
+   if (!bounds.next() || bounds.is_null(0) || bounds.is_null(1))
+      return {};
+   switch (bounds.column_datatype(0))
+   {
       case SQL_BIGINT:
       case SQL_TINYINT:
       case SQL_INTEGER:
       case SQL_SMALLINT:
-         return row.get<std::int64_t>(col);
+         break;
+      default:
+         return {};
+   }
 
-      case SQL_FLOAT:
-      case SQL_REAL:
-      case SQL_DOUBLE:
-         return row.get<double>(col);
+   auto minKey = bounds.get<std::int64_t>(0);
+   auto maxKey = bounds.get<std::int64_t>(1);
+   // unsigned so the span of any int64 range fits
+   auto span = static_cast<std::uint64_t>(maxKey) - static_cast<std::uint64_t>(minKey);
+   auto step = span / partitions + 1;
 
-      // for now, other types, ask odbc to get their string representation
-      // will need to be fixed as needs arise!
-      case SQL_NUMERIC:
-      case SQL_DECIMAL:
-      default:
-         return from_u8string(Cp1252ToUtf8(row.get<std::string>(col)));
+   std::vector<std::string> filters;
+   filters.push_back(std::format("{} IS NULL", key));
+   auto base = static_cast<std::uint64_t>(minKey);
+   for (std::uint64_t offset = 0;; offset += step)
+   {
+      auto low = static_cast<std::int64_t>(base + offset);
+      // last range is left open so rows added since the MIN/MAX query are not lost
+      if (span - offset < step)
+      {
+         filters.push_back(std::format("{} >= {}", key, low));
+         break;
+      }
+      filters.push_back(std::format("{0} >= {1} AND {0} < {2}", key, low, static_cast<std::int64_t>(base + offset + step)));
+   }
+   return filters;
+}
+
+// rows of one extraction query handed to write in order, as they are fetched.
+// with --long-data, rows with memo or blob columns are given to writeLong instead, as the current row
+// of the result set, see LongData.h. with --pipeline, fetching, conversion and write of the other rows
+// overlap, see ExportPipeline.h
+template <typename Write, typename WriteLong>
+size_t WriteRows(nanodbc::connection& conn, const std::string& qry, const ExportOptions& options, const TableTimer& timer, Write&& write, WriteLong&& writeLong)
+{
+   auto       rowIt = ExecuteExtract(conn, qry, options.rowsetSize);
+   RowDecoder decoder(rowIt, *options.codePage, options.blobs);
+   if (options.longData)
+   {
+      LongDataWriter longData(rowIt, decoder, *options.codePage);
+      if (longData.HasLongData())
+      {
+         size_t rowCount {0};
+         while (rowIt.next())
+         {
+            writeLong(longData, rowIt);
+            rowCount++;
+         }
+         return rowCount;
+      }
+   }
+   if (options.pipeline)
+   {
+      PipelineStalls stalls;
+      auto           rowCount = PipelineRows(rowIt, decoder, options.pipelineSizes, write, stalls);
+      timer.Stalls(stalls);
+      return rowCount;
+   }
+
+   size_t   rowCount {0};
+   RowArena arena(options);
+   while (rowIt.next())
+   {
+      write(decoder.DecodeRow(rowIt, arena.Storage()));
+      arena.RowDone();
+      rowCount++;
    }
+   return rowCount;
 }
 
-json::object RowToJsonObject(nanodbc::result& row)
+// rows of one extraction query as they appear inside a table array at indent,
+// the separator of the first one is left to the writer of the array (PrettyWriter::ValueOutput)
+size_t WriteRowsText(nanodbc::connection& conn, const std::string& qry, const ExportOptions& options, const TableTimer& timer, std::string indent, std::ostream& os)
 {
-   json::object                                   rowData;
-   std::vector<std::tuple<unsigned, std::string>> badCols;
-   for (short colIdx = 0; colIdx < row.columns(); colIdx++)
+   JsonOutput out(os);
+   size_t     rowCount {0};
+   auto       separator = [&]()
    {
-      auto&   jsonValue = rowData[row.column_name(colIdx)];
-      DbValue dbValue;
-      try
+      if (rowCount++)
       {
-         dbValue = GetColumnValue(row, colIdx);
+         out.Raw(",\n");
+         out.Raw(indent);
       }
-      catch (std::exception& ex)
+   };
+   WriteRows(conn, qry, options, timer, [&](const json::object& row)
+             {
+                separator();
+                out.Pretty(row, indent);
+             },
+             [&](LongDataWriter& longData, nanodbc::result& row)
+             {
+                separator();
+                longData.Pretty(row, out, indent);
+             });
+   out.Flush();
+   return rowCount;
+}
+
+// structure of array needs the whole table before writing the first column,
+// partitions would have to be merged column by column so the table is read in one query
+json::object ExportColumns(ConnectionPool& pool, const TableExport& tableInfo, const ExportOptions& options)
+{
+   TableTimer            timer(options, tableInfo.name);
+   ConnectionPool::Lease conn(pool);
+   auto                  table = GetStructureOfArray(ExecuteExtract(*conn, tableInfo.ExtractQry(), options.rowsetSize), *options.codePage, options.blobs, options.encode, TableStorage(options));
+   timer.Done(table.at("recordCount").to_number<size_t>());
+   return table;
+}
+
+// stream one table as a json array
+size_t WriteTable(ConnectionPool& pool, const TableExport& tableInfo, const ExportOptions& options, PrettyWriter& writer)
+{
+   if (options.columns)
+   {
+      json::value table    = ExportColumns(pool, tableInfo, options);
+      auto        rowCount = table.at("recordCount").to_number<size_t>();
+      writer.Value(table);
+      return rowCount;
+   }
+
+   TableTimer timer(options, tableInfo.name);
+   size_t     rowCount {0};
+   writer.BeginArray();
+
+   std::vector<std::string> filters;
+   {
+      ConnectionPool::Lease conn(pool);
+      filters = PartitionFilters(*conn, tableInfo, options.partitions);
+      if (filters.empty())
       {
-         badCols.push_back(std::make_tuple(colIdx, ex.what()));
+         rowCount = WriteRows(*conn, tableInfo.ExtractQry(), options, timer, [&](const json::object& row)
+                              { writer.Value(row); },
+                              [&](LongDataWriter& longData, nanodbc::result& row)
+                              {
+                                 auto indent = writer.Indent();
+                                 longData.Pretty(row, writer.ValueOutput(), indent);
+                              });
       }
-      std::visit(ToJsonValue {jsonValue}, dbValue);
    }
-   // if we got bad cols, report them
-   if (!badCols.empty())
+
+   if (!filters.empty())
    {
-      std::string errorMsg = std::format("bad row: [{}]", json::serialize(rowData));
-      for (auto badCol: badCols)
-         errorMsg += std::format("\nError on column: {}, what: {}", row.column_name(std::get<0>(badCol)), std::get<1>(badCol));
-      throw std::runtime_error(errorMsg);
+      // partitions on up to partitionWorkers connections, written in key order: the first one as it is fetched,
+      // the ones ahead of it through temporary files (see OrderedOutput.h)
+      auto                indent = writer.Indent();
+      std::vector<size_t> partsCount(filters.size());
+      JsonOutput*         out {};
+      WriteOrdered(
+         filters.size(), options.partitionWorkers, [&](size_t idx, std::ostream& partOut)
+         {
+            ConnectionPool::Lease conn(pool);
+            partsCount[idx] = WriteRowsText(*conn, tableInfo.ExtractQry(filters[idx]), options, timer, indent, partOut);
+         },
+         [&](size_t)
+         { out = nullptr; },
+         [&](std::string_view text)
+         {
+            // an empty partition writes nothing, not even a separator
+            if (!out)
+               out = &writer.ValueOutput();
+            out->Raw(text);
+         });
+      for (auto count: partsCount)
+         rowCount += count;
    }
 
-   return rowData;
+   writer.EndArray();
+   timer.Done(rowCount);
+   return rowCount;
 }
 
-// could be used for a smaller output
-// at the expanse of readability & having to reconstruct objects
-json::value GetStructureOfArray(nanodbc::result rowIt)
+// write the document as rows are fetched, only one row is ever held as json
+// the layout is the same as pretty_print(jsonDoc)
+// with more than one worker, tables are exported concurrently and written in order:
+// the first one as it is fetched, the ones ahead of it through temporary files (see OrderedOutput.h)
+void ExportStreaming(ConnectionPool& pool, const ExportOptions& options, std::ostream& os)
 {
-   json::object data;
+   PrettyWriter writer(os);
+   writer.BeginObject();
+   writer.Key("version");
+   writer.Value("1.0.0");
+   writer.Key("TlgSchema");
+   writer.BeginObject();
+   if (options.workers > 1)
+   {
+      auto        indent = writer.Indent();
+      JsonOutput* out {};
+      WriteOrdered(
+         g_tablesToExport.size(), options.workers, [&](size_t idx, std::ostream& tableOut)
+         {
+            PrettyWriter tableWriter(tableOut, indent);
+            WriteTable(pool, g_tablesToExport[idx], options, tableWriter);
+            tableWriter.Flush();
+         },
+         [&](size_t idx)
+         {
+            writer.Key(g_tablesToExport[idx].name);
+            out = &writer.ValueOutput();
+         },
+         [&](std::string_view text)
+         { out->Raw(text); });
+   }
+   else
+   {
+      for (const auto& tableInfo: g_tablesToExport)
+      {
+         writer.Key(tableInfo.name);
+         WriteTable(pool, tableInfo, options, writer);
+      }
+   }
+   writer.EndObject();
+   writer.EndObject();
+}
+
+json::value ExportTable(ConnectionPool& pool, const TableExport& tableInfo, const ExportOptions& options)
+{
+   if (options.columns)
+      return ExportColumns(pool, tableInfo, options);
 
-   for (auto colIdx = 0; colIdx < rowIt.columns(); colIdx++)
+   TableTimer               timer(options, tableInfo.name);
+   std::vector<std::string> filters;
    {
-      data[rowIt.column_name(colIdx)] = json::array {};
+      ConnectionPool::Lease conn(pool);
+      filters = PartitionFilters(*conn, tableInfo, options.partitions);
+      if (filters.empty())
+      {
+         auto rows = GetArrayOfStructure(ExecuteExtract(*conn, tableInfo.ExtractQry(), options.rowsetSize), *options.codePage, options.blobs, TableStorage(options));
+         timer.Done(rows.size());
+         return rows;
+      }
    }
 
-   int rowCount {0};
+   std::vector<json::array> parts(filters.size());
+   ParallelFor(filters.size(), options.partitionWorkers, [&](size_t idx)
+               {
+                  ConnectionPool::Lease conn(pool);
+                  parts[idx] = GetArrayOfStructure(ExecuteExtract(*conn, tableInfo.ExtractQry(filters[idx]), options.rowsetSize), *options.codePage, options.blobs);
+               });
 
-   while (rowIt.next())
+   // partitions are in key order, concatenate them.
+   // parts are built on different threads so they can't share an arena,
+   // they use the default storage to be moved and not copied
+   json::array rows;
+   size_t      rowCount {0};
+   for (const auto& part: parts)
+      rowCount += part.size();
+   rows.reserve(rowCount);
+   for (auto& part: parts)
+      for (auto& row: part)
+         rows.push_back(std::move(row));
+   timer.Done(rows.size());
+   return rows;
+}
+
+void ExportDocument(ConnectionPool& pool, const ExportOptions& options, std::ostream& os)
+{
+   // tables are independant reads, each worker uses its own connection.
+   // values are constructed in place, moving a table out of its arena would copy it
+   std::vector<std::optional<json::value>> tablesData(g_tablesToExport.size());
+   ParallelFor(g_tablesToExport.size(), options.workers, [&](size_t idx)
+               {
+                  tablesData[idx].emplace(ExportTable(pool, g_tablesToExport[idx], options));
+               });
+
+   // stitch back in export order, same layout as pretty_print of the whole document
+   PrettyWriter writer(os);
+   writer.BeginObject();
+   writer.Key("version");
+   writer.Value("1.0.0");
+   writer.Key("TlgSchema");
+   writer.BeginObject();
+   for (size_t idx = 0; idx < g_tablesToExport.size(); idx++)
    {
-      rowCount++;
+      writer.Key(g_tablesToExport[idx].name);
+      writer.Value(*tablesData[idx]);
+   }
+   writer.EndObject();
+   writer.EndObject();
+}
 
-      for (auto colIdx = 0; colIdx < rowIt.columns(); colIdx++)
+// only rows inserted, updated or deleted since the previous snapshot, applied by JSon2Access --delta:
+// {
+//   "version" : "1.0.0",
+//   "TlgDelta" : {
+//     "table" : { "inserted" : [ rows ], "updated" : [ rows ], "deleted" : [ key columns ] }
+//   }
+// }
+// the keys and hashes of the previous snapshot are taken first, its DOM is released before the queries
+void ExportDelta(ConnectionPool& pool, const ExportOptions& options, std::ostream& os)
+{
+   std::vector<DeltaTable> deltas;
+   {
+      Snapshot previous(options.deltaFrom, options.workers);
+      deltas.reserve(g_tablesToExport.size());
+      for (const auto& tableInfo: g_tablesToExport)
       {
-         // get Array to populate
-         auto& colArray = data[rowIt.column_name(colIdx)].as_array();
-         auto  dbValue  = GetColumnValue(rowIt, colIdx);
-         std::visit(ToJsonArray {colArray}, dbValue);
+         auto& delta = deltas.emplace_back(tableInfo.KeyColumns());
+         if (previous.HasTable(tableInfo.name))
+            previous.Table(tableInfo.name).ForEach([&](const json::object& row)
+                                                   { delta.AddPrevious(row); });
       }
    }
 
-   json::object object;
-   object["recordCount"] = rowCount;
-   object["data"]        = data;
+   ConnectionPool::Lease conn(pool);
+   PrettyWriter          writer(os);
+   writer.BeginObject();
+   writer.Key("version");
+   writer.Value("1.0.0");
+   writer.Key("TlgDelta");
+   writer.BeginObject();
+   for (size_t idx = 0; idx < g_tablesToExport.size(); idx++)
+   {
+      const auto& tableInfo = g_tablesToExport[idx];
+      auto&       delta     = deltas[idx];
+      TableTimer  timer(options, tableInfo.name);
+
+      size_t     rowCount {0};
+      auto       rowIt = ExecuteExtract(*conn, tableInfo.ExtractQry(), options.rowsetSize);
+      RowDecoder decoder(rowIt, *options.codePage, options.blobs);
+      while (rowIt.next())
+      {
+         delta.AddCurrent(decoder.DecodeRow(rowIt));
+         rowCount++;
+      }
 
-   return object;
+      auto deleted = delta.Deleted();
+      writer.Key(tableInfo.name);
+      writer.BeginObject();
+      writer.Key("inserted");
+      writer.Value(delta.Inserted());
+      writer.Key("updated");
+      writer.Value(delta.Updated());
+      writer.Key("deleted");
+      writer.Value(deleted);
+      writer.EndObject();
+
+      std::cerr << std::format("{}: {} inserted, {} updated, {} deleted, {} unchanged", tableInfo.name, delta.Inserted().size(), delta.Updated().size(), deleted.size(), delta.Unchanged()) << std::endl;
+      timer.Done(rowCount);
+      delta = DeltaTable(tableInfo.KeyColumns());   // its rows are released
+   }
+   writer.EndObject();
+   writer.EndObject();
 }
 
-json::array GetArrayOfStructure(nanodbc::result rowIt)
+// ndjson snapshot, see Snapshot.h: a {"TlgTable":"name"} line then one compact row per line.
+// lines of partitions simply follow each other. with more than one worker, tables and partitions
+// are exported concurrently and written in order, as ExportStreaming does
+void ExportNdjson(ConnectionPool& pool, const ExportOptions& options, std::ostream& os)
 {
-   json::array rows;
-   while (rowIt.next())
+   auto writeLines = [&](nanodbc::connection& conn, const std::string& qry, const TableTimer& timer, JsonOutput& out)
+   {
+      return WriteRows(conn, qry, options, timer, [&](const json::object& row)
+                       {
+                          out.Compact(row);
+                          out.Raw("\n");
+                       },
+                       [&](LongDataWriter& longData, nanodbc::result& row)
+                       {
+                          longData.Compact(row, out);
+                          out.Raw("\n");
+                       });
+   };
+
+   auto writeTable = [&](const TableExport& tableInfo, JsonOutput& out)
+   {
+      TableTimer timer(options, tableInfo.name);
+      out.Raw("{\"");
+      out.Raw(ndjson_table_key);
+      out.Raw("\":");
+      out.String(tableInfo.name);
+      out.Raw("}\n");
+
+      size_t                   rowCount {0};
+      std::vector<std::string> filters;
+      {
+         ConnectionPool::Lease conn(pool);
+         filters = PartitionFilters(*conn, tableInfo, options.partitions);
+         if (filters.empty())
+            rowCount = writeLines(*conn, tableInfo.ExtractQry(), timer, out);
+      }
+      if (!filters.empty())
+      {
+         std::vector<size_t> partsCount(filters.size());
+         WriteOrdered(
+            filters.size(), options.partitionWorkers, [&](size_t idx, std::ostream& partOut)
+            {
+               ConnectionPool::Lease conn(pool);
+               JsonOutput            lines(partOut);
+               partsCount[idx] = writeLines(*conn, tableInfo.ExtractQry(filters[idx]), timer, lines);
+               lines.Flush();
+            },
+            [](size_t) {},
+            [&](std::string_view text)
+            { out.Raw(text); });
+         for (auto count: partsCount)
+            rowCount += count;
+      }
+      timer.Done(rowCount);
+   };
+
+   JsonOutput out(os);
+   if (options.workers > 1)
+   {
+      WriteOrdered(
+         g_tablesToExport.size(), options.workers, [&](size_t idx, std::ostream& tableOut)
+         {
+            JsonOutput lines(tableOut);
+            writeTable(g_tablesToExport[idx], lines);
+            lines.Flush();
+         },
+         [](size_t) {},
+         [&](std::string_view text)
+         { out.Raw(text); });
+   }
+   else
    {
-      rows.push_back(RowToJsonObject(rowIt));
+      for (const auto& tableInfo: g_tablesToExport)
+         writeTable(tableInfo, out);
    }
-   return rows;
+   out.Flush();
+}
+
+// tables are converted one at a time, see BinarySnapshot.h
+void ExportBinary(ConnectionPool& pool, const ExportOptions& options, std::ostream& os)
+{
+   BinarySnapshotWriter writer(os, static_cast<std::uint32_t>(g_tablesToExport.size()));
+   for (const auto& tableInfo: g_tablesToExport)
+   {
+      writer.AddTable(tableInfo.name, ExportColumns(pool, tableInfo, options));
+   }
+   writer.Close();
+}
+
+void Export(ConnectionPool& pool, const ExportOptions& options, std::ostream& os)
+{
+   if (!options.deltaFrom.empty())
+      ExportDelta(pool, options, os);
+   else if (options.binary)
+      ExportBinary(pool, options, os);
+   else if (options.ndjson)
+      ExportNdjson(pool, options, os);
+   else if (options.stream)
+      ExportStreaming(pool, options, os);
+   else
+      ExportDocument(pool, options, os);
 }
 
-std::string readJsonFile(const std::string& filename)
+ExportOptions GetExportOptions(const CmdLine& cmdLine)
 {
-   std::ifstream input(filename);
-   return std::string((std::istreambuf_iterator<char>(input)),
-                      std::istreambuf_iterator<char>());
+   ExportOptions options;
+   // the connection can be overriden, ex: to benchmark against another odbc driver
+   options.connection = cmdLine.Get("connection", "Driver={Microsoft Access Driver (*.mdb, *.accdb)};Dbq=" + cmdLine.Positional()[0]);
+   options.stream     = cmdLine.Has("stream");
+   options.rowsetSize = static_cast<long>(std::max<size_t>(1, cmdLine.GetSize("rowset", default_rowset_size)));
+   options.timing     = cmdLine.Has("timing");
+   options.arena      = !cmdLine.Has("no-arena");
+   options.workers    = std::max<size_t>(1, cmdLine.GetSize("workers", 1));
+   options.partitions = std::max<size_t>(1, cmdLine.GetSize("partitions", 1));
+   options.encode     = cmdLine.Has("encode");
+   options.pipeline   = cmdLine.Has("pipeline");
+   options.longData   = cmdLine.Has("long-data");
+   options.blobs      = options.longData ? BlobFormat::Base64 : BlobFormat::Array;
+   options.codePage   = &CodePage::Get(cmdLine.Get("codepage", "1252"));
+
+   options.pipelineSizes.batchRows  = std::max<size_t>(1, cmdLine.GetSize("batch", options.pipelineSizes.batchRows));
+   options.pipelineSizes.queueDepth = std::max<size_t>(1, cmdLine.GetSize("queue", options.pipelineSizes.queueDepth));
+
+   // tables run concurrently on workers threads: each one reads its partitions on its share of them,
+   // so that at most workers connections are open
+   options.partitionWorkers = std::max<size_t>(1, options.workers / std::min(options.workers, g_tablesToExport.size()));
+
+   // an array of object is more verbose, but easier to visualise and diff
+   // structure of array is more memory friendly, but less intuitive
+   // see https://en.wikipedia.org/wiki/AoS_and_SoA
+   auto layout = cmdLine.Get("layout", "rows");
+   if (layout != "rows" && layout != "columns")
+      throw std::runtime_error(std::format("unknown layout: {}, expecting rows or columns", layout));
+   options.columns = layout == "columns";
+
+   auto format = cmdLine.Get("format", "json");
+   if (format != "json" && format != "binary" && format != "ndjson")
+      throw std::runtime_error(std::format("unknown format: {}, expecting json, ndjson or binary", format));
+   options.binary    = format == "binary";
+   options.ndjson    = format == "ndjson";
+   options.deltaFrom = cmdLine.Get("delta");
+   if ((options.binary || options.ndjson) && !options.deltaFrom.empty())
+      throw std::runtime_error("a delta is only available in json format");
+   if (options.ndjson && options.columns)
+      throw std::runtime_error("ndjson is one row per line, it has no columns layout");
+   // the pipeline streams rows: json rows are then streamed too
+   if (options.pipeline && (options.binary || options.columns || !options.deltaFrom.empty()))
+      throw std::runtime_error("the pipeline streams rows, it has no binary, columns layout or delta output");
+   options.stream = options.stream || options.pipeline;
+   if (options.longData && options.binary)
+      throw std::runtime_error("binary snapshots store memo and blob columns as they are, without --long-data");
+   if (options.binary && cmdLine.Positional().size() < 2)
+      throw std::runtime_error("binary format needs an output file");
+   return options;
 }
 
 int main(int argc, char** argv)
 {
-   std::cout << "Copyright © Jada Informatique 2021." << std::endl;
+   std::cerr << "Copyright © Jada Informatique 2021." << std::endl;
 #if defined(_WIN32)
    #if defined(_WIN64)
-   std::cout << "using Odbc 64 bits" << std::endl;
+   std::cerr << "using Odbc 64 bits" << std::endl;
    #elif defined(_M_IX86)
-   std::cout << "using Odbc 32 bits" << std::endl;
+   std::cerr << "using Odbc 32 bits" << std::endl;
    #endif
 #endif
 
-   std::string database {argv[1]};
-   auto        connection_string = "Driver={Microsoft Access Driver (*.mdb, *.accdb)};Dbq=" + database;
-
    try
    {
-      nanodbc::connection conn(connection_string);
+      CmdLine cmdLine(argc, argv);
+      if (cmdLine.Positional().empty())
+      {
+         std::cerr << "usage: TlgAccess2Json database [output.json] [--stream] [--rowset=rows] [--timing] [--no-arena] [--workers=threads] [--partitions=ranges] [--layout=rows|columns] [--encode] [--format=json|ndjson|binary] [--pipeline] [--batch=rows] [--queue=batches] [--long-data] [--delta=previous snapshot] [--codepage=name] [--connection=odbc connection string]" << std::endl;
+         return 1;
+      }
+
+      auto options = GetExportOptions(cmdLine);
+
+      ConnectionPool      pool(options.connection);
+      nanodbc::connection conn = pool.Acquire();
 
       SQLUINTEGER uIntVal {};
       SQLGetEnvAttr(conn.native_env_handle(), SQL_ATTR_ODBC_VERSION, static_cast<SQLPOINTER>(&uIntVal), static_cast<SQLINTEGER>(sizeof(uIntVal)), nullptr);
-      std::cout << std::format("odbc version: {}", uIntVal) << std::endl;
-      json::object jsonDoc;
-      jsonDoc["version"] = "1.0.0";
-      json::object tables;
+      std::cerr << std::format("odbc version: {}", uIntVal) << std::endl;
+      pool.Release(std::move(conn));
 
-      for (auto tableInfo: g_tablesToExport)
+      if (cmdLine.Positional().size() > 1)
       {
-         auto rowIt = nanodbc::execute(conn, tableInfo.extractQry);
-         // an array of object is more verbose, but easier to visualise and diff
-         tables[tableInfo.name] = GetArrayOfStructure(rowIt);
-
-         // structure of array would be more memory friendly, but less intuitive
-         // see https://en.wikipedia.org/wiki/AoS_and_SoA
-         // tables[tableInfo.name] = GetStructureOfArray(rowIt);
-      }
-      jsonDoc["TlgSchema"] = tables;
-      if (argc > 2)
-      {
-         std::ofstream fileOut(argv[2]);
-         pretty_print(fileOut, jsonDoc);
+         std::ofstream fileOut(cmdLine.Positional()[1], options.binary ? std::ios::binary : std::ios::out);
+         Export(pool, options, fileOut);
       }
       else
       {
-         pretty_print(std::cout, jsonDoc);
+         Export(pool, options, std::cout);
       }
+
+      if (options.timing)
+         std::cerr << std::format("allocations: {}, peak memory: {} MB", GetAllocationCount(), GetPeakMemory() / (1024 * 1024)) << std::endl;
    }
    catch (const std::exception& e)
    {
-      std::cerr << e.what() << '\n';
+      std::cerr << ToConsole(e.what()) << '\n';
    }
    return 0;
 }
@@ -0,0 +1,120 @@
+#include "Base64.h"
+
+#include <array>
+#include <cstdint>
+
+#if defined(__SSSE3__) || defined(__AVX__)
+   #include <tmmintrin.h>
+   #define BASE64_SSSE3
+#endif
+
+namespace
+{
+   constexpr char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+   constexpr std::uint8_t invalid = 0xff;
+
+   constexpr std::array<std::uint8_t, 256> decode_table = []()
+   {
+      std::array<std::uint8_t, 256> table {};
+      table.fill(invalid);
+      for (std::uint8_t idx = 0; idx < 64; idx++)
+         table[static_cast<unsigned char>(alphabet[idx])] = idx;
+      return table;
+   }();
+
+#if defined(BASE64_SSSE3)
+   // W. Mula and D. Lemire, "Faster Base64 Encoding and Decoding using AVX2 Instructions":
+   // the 12 bytes of in are spread to 16 sextets, which are then shifted into the alphabet
+   __m128i EncodeBlock(__m128i in)
+   {
+      in = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+
+      auto t0      = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+      auto t1      = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+      auto t2      = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+      auto t3      = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+      auto sextets = _mm_or_si128(t1, t3);
+
+      // index of the shift: 0 for 'a'..'z' (26..51), 1..10 for digits, 11 '+', 12 '/', 13 for 'A'..'Z'
+      auto range = _mm_subs_epu8(sextets, _mm_set1_epi8(51));
+      auto upper = _mm_cmpgt_epi8(_mm_set1_epi8(26), sextets);
+      range      = _mm_or_si128(range, _mm_and_si128(upper, _mm_set1_epi8(13)));
+
+      const auto shifts = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                        '+' - 62, '/' - 63, 'A', 0, 0);
+      return _mm_add_epi8(_mm_shuffle_epi8(shifts, range), sextets);
+   }
+#endif
+}   // namespace
+
+void Base64Encode(const void* data, size_t size, char* out)
+{
+   auto in  = static_cast<const unsigned char*>(data);
+   auto end = in + size;
+
+#if defined(BASE64_SSSE3)
+   // blocks are loaded 16 bytes at a time, the last 4 are those of the next block
+   while (end - in >= 16)
+   {
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out), EncodeBlock(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in))));
+      in += 12;
+      out += 16;
+   }
+#endif
+
+   for (; end - in >= 3; in += 3)
+   {
+      std::uint32_t bits = (in[0] << 16) | (in[1] << 8) | in[2];
+      *out++             = alphabet[bits >> 18];
+      *out++             = alphabet[(bits >> 12) & 0x3f];
+      *out++             = alphabet[(bits >> 6) & 0x3f];
+      *out++             = alphabet[bits & 0x3f];
+   }
+   if (end - in == 1)
+   {
+      *out++ = alphabet[in[0] >> 2];
+      *out++ = alphabet[(in[0] & 0x03) << 4];
+      *out++ = '=';
+      *out++ = '=';
+   }
+   else if (end - in == 2)
+   {
+      *out++ = alphabet[in[0] >> 2];
+      *out++ = alphabet[((in[0] & 0x03) << 4) | (in[1] >> 4)];
+      *out++ = alphabet[(in[1] & 0x0f) << 2];
+      *out++ = '=';
+   }
+}
+
+std::optional<size_t> Base64Decode(std::string_view text, char* out)
+{
+   if (text.size() % 4)
+      return std::nullopt;
+
+   size_t padding = text.ends_with("==") ? 2 : (text.ends_with('=') ? 1 : 0);
+   auto   start   = out;
+   for (size_t pos = 0; pos < text.size(); pos += 4)
+   {
+      bool          last = pos + 4 == text.size();
+      std::uint32_t bits {};
+      for (size_t idx = 0; idx < 4; idx++)
+      {
+         auto sextet = decode_table[static_cast<unsigned char>(text[pos + idx])];
+         if (sextet == invalid)
+         {
+            // only the padding of the last group
+            if (!last || idx < 4 - padding)
+               return std::nullopt;
+            sextet = 0;
+         }
+         bits = (bits << 6) | sextet;
+      }
+      *out++ = static_cast<char>(bits >> 16);
+      if (!last || padding < 2)
+         *out++ = static_cast<char>(bits >> 8);
+      if (!last || padding < 1)
+         *out++ = static_cast<char>(bits);
+   }
+   return static_cast<size_t>(out - start);
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <string_view>
+
+// base64 of the blobs in a json snapshot (rfc 4648 alphabet, with padding)
+
+constexpr size_t Base64EncodedSize(size_t size) { return (size + 2) / 3 * 4; }
+constexpr size_t MaxBase64DecodedSize(size_t size) { return size / 4 * 3; }
+
+// writes Base64EncodedSize(size) characters to out.
+// with SSSE3, 12 bytes are encoded to 16 characters at a time
+void Base64Encode(const void* data, size_t size, char* out);
+
+// writes at most MaxBase64DecodedSize(text.size()) bytes to out, returns their count.
+// nothing when text is not base64: bad length, padding or character
+std::optional<size_t> Base64Decode(std::string_view text, char* out);
@@ -0,0 +1,397 @@
+#include "BinarySnapshot.h"
+
+#include <bit>
+#include <cstring>
+#include <format>
+#include <stdexcept>
+#include <string>
+
+#include "Columnar.h"
+
+namespace json = boost::json;
+
+static_assert(std::endian::native == std::endian::little, "snapshot numbers are little endian");
+
+namespace
+{
+   constexpr char          snapshot_magic[8] = {'T', 'L', 'G', 'S', 'N', 'A', 'P', '1'};
+   constexpr std::uint32_t snapshot_version  = 1;
+   constexpr size_t        file_header_size  = sizeof(snapshot_magic) + 2 * sizeof(std::uint32_t);
+
+   // mapped data has no alignment guarantee for the compiler, memcpy is free once optimized
+   template <typename T>
+   T Read(const char* p)
+   {
+      T value;
+      std::memcpy(&value, p, sizeof(T));
+      return value;
+   }
+
+   template <typename T>
+   std::uint64_t Append(std::string& out, const T* data, size_t count)
+   {
+      std::uint64_t offset = out.size();
+      out.append(reinterpret_cast<const char*>(data), count * sizeof(T));
+      return offset;
+   }
+
+   void Align(std::string& out)
+   {
+      out.resize((out.size() + 7) & ~size_t {7}, '\0');
+   }
+
+   SnapshotColumnType GetColumnType(const json::array& values, std::string_view columnName)
+   {
+      bool hasInteger {}, hasDouble {}, hasString {}, hasBinary {};
+      for (const auto& value: values)
+      {
+         switch (value.kind())
+         {
+            case json::kind::int64:
+            case json::kind::uint64:
+               hasInteger = true;
+               break;
+            case json::kind::double_:
+               hasDouble = true;
+               break;
+            case json::kind::string:
+               hasString = true;
+               break;
+            case json::kind::array:
+               hasBinary = true;
+               break;
+            case json::kind::null:
+               break;
+            default:
+               throw std::runtime_error(std::format("column {}: invalid json kind for snapshot", columnName));
+         }
+      }
+      if (int(hasString) + int(hasBinary) + int(hasInteger || hasDouble) > 1)
+         throw std::runtime_error(std::format("column {}: mixed value types", columnName));
+
+      if (hasString)
+         return SnapshotColumnType::String;
+      if (hasBinary)
+         return SnapshotColumnType::Binary;
+      if (hasDouble)
+         return SnapshotColumnType::Double;
+      // all NULL columns end up here too
+      return SnapshotColumnType::Int64;
+   }
+
+   void AppendColumn(std::string& out, SnapshotColumnHeader& header, const json::array& values)
+   {
+      auto rowCount = values.size();
+
+      // nulls bitmap, only if needed
+      std::vector<std::uint8_t> nulls((rowCount + 7) / 8);
+      bool                      hasNull {};
+      for (size_t row = 0; row < rowCount; row++)
+      {
+         if (values[row].is_null())
+         {
+            nulls[row / 8] |= std::uint8_t(1u << (row % 8));
+            hasNull = true;
+         }
+      }
+      header.nullsOffset = 0;
+      if (hasNull)
+      {
+         header.nullsOffset = Append(out, nulls.data(), nulls.size());
+         Align(out);
+      }
+
+      switch (header.type)
+      {
+         case SnapshotColumnType::Int64:
+         {
+            std::vector<std::int64_t> data(rowCount);
+            for (size_t row = 0; row < rowCount; row++)
+               if (!values[row].is_null())
+                  data[row] = values[row].to_number<std::int64_t>();
+            header.dataOffset = Append(out, data.data(), data.size());
+            break;
+         }
+
+         case SnapshotColumnType::Double:
+         {
+            std::vector<double> data(rowCount);
+            for (size_t row = 0; row < rowCount; row++)
+               if (!values[row].is_null())
+                  data[row] = values[row].to_number<double>();
+            header.dataOffset = Append(out, data.data(), data.size());
+            break;
+         }
+
+         case SnapshotColumnType::String:
+         case SnapshotColumnType::Binary:
+         {
+            std::vector<std::uint64_t> offsets;
+            std::string                blob;
+            offsets.reserve(rowCount + 1);
+            offsets.push_back(0);
+            for (const auto& value: values)
+            {
+               if (value.is_string())
+               {
+                  blob.append(value.get_string().data(), value.get_string().size());
+               }
+               else if (value.is_array())
+               {
+                  for (const auto& byte: value.get_array())
+                     blob.push_back(static_cast<char>(byte.to_number<std::uint8_t>()));
+               }
+               offsets.push_back(blob.size());
+            }
+            header.dataOffset = Append(out, offsets.data(), offsets.size());
+            header.blobOffset = Append(out, blob.data(), blob.size());
+            header.blobSize   = blob.size();
+            break;
+         }
+      }
+      Align(out);
+   }
+}   // namespace
+
+bool IsBinarySnapshot(std::string_view data)
+{
+   return data.size() >= file_header_size && std::memcmp(data.data(), snapshot_magic, sizeof(snapshot_magic)) == 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+BinarySnapshotWriter::BinarySnapshotWriter(std::ostream& os, std::uint32_t tableCount) :
+   m_Os(os), m_TableCount(tableCount)
+{
+   std::string header(snapshot_magic, sizeof(snapshot_magic));
+   Append(header, &snapshot_version, 1);
+   Append(header, &tableCount, 1);
+   // table offsets are filled by Close()
+   header.resize(header.size() + tableCount * sizeof(std::uint64_t), '\0');
+   Align(header);
+   m_Os.write(header.data(), header.size());
+   m_Position = header.size();
+}
+
+void BinarySnapshotWriter::AddTable(std::string_view name, const json::object& table)
+{
+   if (m_TableOffsets.size() == m_TableCount)
+      throw std::runtime_error(std::format("snapshot already has its {} table(s)", m_TableCount));
+
+   const auto& data = table.at("data").as_object();
+
+   SnapshotTableHeader tableHeader {};
+   tableHeader.rowCount    = table.at("recordCount").to_number<std::uint64_t>();
+   tableHeader.columnCount = static_cast<std::uint32_t>(data.size());
+   tableHeader.nameSize    = static_cast<std::uint32_t>(name.size());
+
+   std::vector<SnapshotColumnHeader> columnHeaders(data.size());
+
+   // headers are written once the offsets are known
+   std::string out(sizeof(tableHeader) + columnHeaders.size() * sizeof(SnapshotColumnHeader), '\0');
+   tableHeader.nameOffset = Append(out, name.data(), name.size());
+   Align(out);
+
+   size_t col = 0;
+   for (const auto& column: data)
+   {
+      auto& header    = columnHeaders[col++];
+      auto  values    = DecodeColumn(column.value(), static_cast<size_t>(tableHeader.rowCount));
+      auto  colName   = std::string_view(column.key().data(), column.key().size());
+      header.nameSize = static_cast<std::uint32_t>(colName.size());
+      if (values.size() != tableHeader.rowCount)
+         throw std::runtime_error(std::format("column {} has {} value(s), expected {}", colName, values.size(), tableHeader.rowCount));
+
+      header.nameOffset = Append(out, colName.data(), colName.size());
+      Align(out);
+      header.type = GetColumnType(values, colName);
+      AppendColumn(out, header, values);
+   }
+
+   std::memcpy(out.data(), &tableHeader, sizeof(tableHeader));
+   std::memcpy(out.data() + sizeof(tableHeader), columnHeaders.data(), columnHeaders.size() * sizeof(SnapshotColumnHeader));
+
+   m_TableOffsets.push_back(m_Position);
+   m_Os.write(out.data(), out.size());
+   m_Position += out.size();
+}
+
+void BinarySnapshotWriter::Close()
+{
+   if (m_TableOffsets.size() != m_TableCount)
+      throw std::runtime_error(std::format("snapshot has {} table(s), expected {}", m_TableOffsets.size(), m_TableCount));
+
+   m_Os.seekp(file_header_size);
+   m_Os.write(reinterpret_cast<const char*>(m_TableOffsets.data()), m_TableOffsets.size() * sizeof(std::uint64_t));
+   m_Os.seekp(m_Position);
+   m_Os.flush();
+   if (!m_Os)
+      throw std::runtime_error("can't write binary snapshot, output must be a file");
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+BinaryTable::BinaryTable(std::string_view snapshot, std::uint64_t offset)
+{
+   auto checkRange = [&](std::uint64_t start, std::uint64_t size)
+   {
+      auto available = snapshot.size() - offset;
+      if (start > available || size > available - start)
+         throw std::runtime_error("corrupted binary snapshot, section out of file");
+   };
+
+   if (offset > snapshot.size())
+      throw std::runtime_error("corrupted binary snapshot, table out of file");
+   checkRange(0, sizeof(SnapshotTableHeader));
+
+   m_Table  = snapshot.data() + offset;
+   m_Header = Read<SnapshotTableHeader>(m_Table);
+   checkRange(sizeof(SnapshotTableHeader), std::uint64_t {m_Header.columnCount} * sizeof(SnapshotColumnHeader));
+   checkRange(m_Header.nameOffset, m_Header.nameSize);
+   // a value takes at least 8 bytes, the sizes computed from rowCount below can't overflow
+   if (m_Header.rowCount > snapshot.size() / 8)
+      throw std::runtime_error("corrupted binary snapshot, row count larger than the file");
+
+   m_Columns.reserve(m_Header.columnCount);
+   for (size_t col = 0; col < m_Header.columnCount; col++)
+   {
+      auto header = Read<SnapshotColumnHeader>(m_Table + sizeof(SnapshotTableHeader) + col * sizeof(SnapshotColumnHeader));
+      checkRange(header.nameOffset, header.nameSize);
+      if (header.nullsOffset)
+         checkRange(header.nullsOffset, (m_Header.rowCount + 7) / 8);
+      switch (header.type)
+      {
+         case SnapshotColumnType::Int64:
+         case SnapshotColumnType::Double:
+            checkRange(header.dataOffset, m_Header.rowCount * 8);
+            break;
+         case SnapshotColumnType::String:
+         case SnapshotColumnType::Binary:
+            checkRange(header.dataOffset, (m_Header.rowCount + 1) * 8);
+            checkRange(header.blobOffset, header.blobSize);
+            break;
+         default:
+            throw std::runtime_error(std::format("corrupted binary snapshot, unknown column type {}", std::uint32_t(header.type)));
+      }
+      m_Columns.push_back(header);
+   }
+}
+
+std::string_view BinaryTable::Name() const
+{
+   return {m_Table + m_Header.nameOffset, m_Header.nameSize};
+}
+
+std::string_view BinaryTable::ColumnName(size_t col) const
+{
+   return {m_Table + m_Columns[col].nameOffset, m_Columns[col].nameSize};
+}
+
+bool BinaryTable::IsNull(size_t col, size_t row) const
+{
+   const auto& header = m_Columns[col];
+   return header.nullsOffset && ((m_Table[header.nullsOffset + row / 8] >> (row % 8)) & 1);
+}
+
+std::int64_t BinaryTable::Int64(size_t col, size_t row) const
+{
+   return Read<std::int64_t>(m_Table + m_Columns[col].dataOffset + row * sizeof(std::int64_t));
+}
+
+double BinaryTable::Double(size_t col, size_t row) const
+{
+   return Read<double>(m_Table + m_Columns[col].dataOffset + row * sizeof(double));
+}
+
+std::string_view BinaryTable::Bytes(size_t col, size_t row) const
+{
+   const auto& header = m_Columns[col];
+   auto        begin  = Read<std::uint64_t>(m_Table + header.dataOffset + row * sizeof(std::uint64_t));
+   auto        end    = Read<std::uint64_t>(m_Table + header.dataOffset + (row + 1) * sizeof(std::uint64_t));
+   if (begin > end || end > header.blobSize)
+      throw std::runtime_error(std::format("corrupted binary snapshot, column {} row {}", ColumnName(col), row));
+   return {m_Table + header.blobOffset + begin, end - begin};
+}
+
+json::value BinaryTable::Value(size_t col, size_t row) const
+{
+   if (IsNull(col, row))
+      return nullptr;
+
+   switch (ColumnType(col))
+   {
+      case SnapshotColumnType::Int64:
+         return Int64(col, row);
+      case SnapshotColumnType::Double:
+         return Double(col, row);
+      case SnapshotColumnType::String:
+         return json::string_view(Bytes(col, row).data(), Bytes(col, row).size());
+      case SnapshotColumnType::Binary:
+      {
+         // blobs are exported as an array of bytes
+         json::array bytes;
+         for (auto byte: Bytes(col, row))
+            bytes.push_back(static_cast<std::uint8_t>(byte));
+         return bytes;
+      }
+   }
+   return nullptr;
+}
+
+json::object BinaryTable::Row(size_t row) const
+{
+   json::object rowData;
+   rowData.reserve(Columns());
+   for (size_t col = 0; col < Columns(); col++)
+      rowData[json::string_view(ColumnName(col).data(), ColumnName(col).size())] = Value(col, row);
+   return rowData;
+}
+
+json::object BinaryTable::ToColumnar() const
+{
+   json::object data;
+   for (size_t col = 0; col < Columns(); col++)
+   {
+      json::array values;
+      values.reserve(size());
+      for (size_t row = 0; row < size(); row++)
+         values.push_back(Value(col, row));
+      data[json::string_view(ColumnName(col).data(), ColumnName(col).size())] = std::move(values);
+   }
+
+   json::object table;
+   table["recordCount"] = size();
+   table["data"]        = std::move(data);
+   return table;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+BinarySnapshotReader::BinarySnapshotReader(std::string_view data) :
+   m_Data(data)
+{
+   if (!IsBinarySnapshot(data))
+      throw std::runtime_error("not a binary snapshot");
+   auto version = Read<std::uint32_t>(data.data() + sizeof(snapshot_magic));
+   if (version != snapshot_version)
+      throw std::runtime_error(std::format("unsupported binary snapshot version: {}", version));
+   m_TableCount = Read<std::uint32_t>(data.data() + sizeof(snapshot_magic) + sizeof(std::uint32_t));
+   if ((data.size() - file_header_size) / sizeof(std::uint64_t) < m_TableCount)
+      throw std::runtime_error("corrupted binary snapshot, table directory out of file");
+}
+
+BinaryTable BinarySnapshotReader::Table(size_t idx) const
+{
+   return BinaryTable(m_Data, Read<std::uint64_t>(m_Data.data() + file_header_size + idx * sizeof(std::uint64_t)));
+}
+
+std::optional<BinaryTable> BinarySnapshotReader::Find(std::string_view name) const
+{
+   for (size_t idx = 0; idx < Tables(); idx++)
+   {
+      auto table = Table(idx);
+      if (table.Name() == name)
+         return table;
+   }
+   return std::nullopt;
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+#include <boost/json.hpp>
+
+// compact binary snapshot, one file per export, meant to be memory mapped
+// so a column can be read without parsing anything:
+//
+//   file header   : magic "TLGSNAP1", uint32 version, uint32 table count,
+//                   then the uint64 file offset of each table
+//   table header  : SnapshotTableHeader followed by one SnapshotColumnHeader per column
+//
+// offsets in a table are relative to its header and every section is 8 bytes aligned.
+// Int64 and Double columns are row count values, NULL rows hold 0.
+// String (utf8) and Binary columns are row count + 1 uint64 offsets into the blob,
+// the value of a row being blob[offsets[row], offsets[row + 1]).
+// nulls is a bitmap of row count bits, a set bit is NULL.
+// numbers are little endian, like the machines we run on
+
+enum class SnapshotColumnType : std::uint32_t
+{
+   Int64  = 1,
+   Double = 2,
+   String = 3,
+   Binary = 4,
+};
+
+struct SnapshotTableHeader
+{
+   std::uint64_t rowCount;
+   std::uint32_t columnCount;
+   std::uint32_t nameSize;
+   std::uint64_t nameOffset;
+};
+static_assert(sizeof(SnapshotTableHeader) == 24);
+
+struct SnapshotColumnHeader
+{
+   SnapshotColumnType type;
+   std::uint32_t      nameSize;
+   std::uint64_t      nameOffset;
+   std::uint64_t      nullsOffset;   // 0: column has no NULL
+   std::uint64_t      dataOffset;
+   std::uint64_t      blobOffset;   // String and Binary only
+   std::uint64_t      blobSize;
+};
+static_assert(sizeof(SnapshotColumnHeader) == 48);
+
+bool IsBinarySnapshot(std::string_view data);
+
+// tables are written one at a time from the structure of array layout (see Columnar.h),
+// the stream must be seekable: the table offsets are filled by Close()
+class BinarySnapshotWriter
+{
+   std::ostream&              m_Os;
+   std::uint32_t              m_TableCount;
+   std::uint64_t              m_Position {};
+   std::vector<std::uint64_t> m_TableOffsets;
+
+public:
+   BinarySnapshotWriter(std::ostream& os, std::uint32_t tableCount);
+
+   void AddTable(std::string_view name, const boost::json::object& table);
+   void Close();
+};
+
+// view on one table of a snapshot, the snapshot data must outlive it
+class BinaryTable
+{
+   const char*                       m_Table {};
+   SnapshotTableHeader               m_Header {};
+   std::vector<SnapshotColumnHeader> m_Columns;
+
+public:
+   BinaryTable(std::string_view snapshot, std::uint64_t offset);
+
+   std::string_view Name() const;
+   size_t           size() const { return m_Header.rowCount; }
+   size_t           Columns() const { return m_Columns.size(); }
+
+   std::string_view   ColumnName(size_t col) const;
+   SnapshotColumnType ColumnType(size_t col) const { return m_Columns[col].type; }
+
+   bool             IsNull(size_t col, size_t row) const;
+   std::int64_t     Int64(size_t col, size_t row) const;
+   double           Double(size_t col, size_t row) const;
+   std::string_view Bytes(size_t col, size_t row) const;   // String and Binary
+
+   // json as exported by TlgAccess2Json
+   boost::json::value  Value(size_t col, size_t row) const;
+   boost::json::object Row(size_t row) const;
+   boost::json::object ToColumnar() const;
+};
+
+class BinarySnapshotReader
+{
+   std::string_view m_Data;
+   std::uint32_t    m_TableCount {};
+
+public:
+   explicit BinarySnapshotReader(std::string_view data);
+
+   size_t                     Tables() const { return m_TableCount; }
+   BinaryTable                Table(size_t idx) const;
+   std::optional<BinaryTable> Find(std::string_view name) const;
+};
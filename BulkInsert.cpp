@@ -0,0 +1,625 @@
+#include "BulkInsert.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <limits>
+#include <stdexcept>
+
+#include "Base64.h"
+#include "utf8Conversion.h"
+
+namespace json = boost::json;
+
+namespace
+{
+   enum class ParamKind
+   {
+      Integer,
+      BigInt,
+      Double,
+      Text,
+      Timestamp,
+      Binary
+   };
+
+   // what the import knows how to store, see ToDb in the previous versions
+   bool IsDbKind(json::kind kind)
+   {
+      switch (kind)
+      {
+         case json::kind::uint64:
+         case json::kind::int64:
+         case json::kind::double_:
+         case json::kind::string:
+         case json::kind::null:
+            return true;
+      }
+      return false;
+   }
+
+   // access INTEGER is 32 bits, larger numbers are sent as double
+   bool FitsInteger(const json::value& jv)
+   {
+      if (jv.is_int64())
+         return jv.get_int64() >= std::numeric_limits<SQLINTEGER>::min() && jv.get_int64() <= std::numeric_limits<SQLINTEGER>::max();
+      if (jv.is_uint64())
+         return jv.get_uint64() <= static_cast<std::uint64_t>(std::numeric_limits<SQLINTEGER>::max());
+      return false;
+   }
+
+   bool FitsBigInt(const json::value& jv)
+   {
+      return jv.is_int64() || (jv.is_uint64() && jv.get_uint64() <= static_cast<std::uint64_t>(std::numeric_limits<std::int64_t>::max()));
+   }
+
+   bool IsBinaryType(SQLSMALLINT sqlType)
+   {
+      switch (sqlType)
+      {
+         case SQL_BINARY:
+         case SQL_VARBINARY:
+         case SQL_LONGVARBINARY:
+            return true;
+      }
+      return false;
+   }
+
+   bool IsTimestampType(SQLSMALLINT sqlType)
+   {
+      switch (sqlType)
+      {
+         case SQL_TYPE_TIMESTAMP:
+         case SQL_TYPE_DATE:
+         case SQL_TYPE_TIME:
+         case SQL_TIMESTAMP:
+         case SQL_DATE:
+         case SQL_TIME:
+            return true;
+      }
+      return false;
+   }
+
+   // text of a timestamp as odbc converts it to SQL_C_CHAR: yyyy-mm-dd[ hh:mm:ss[.fraction]]
+   bool ParseTimestamp(std::string_view text, SQL_TIMESTAMP_STRUCT& ts)
+   {
+      ts = {};
+      auto field = [&](size_t pos, size_t size, auto& value, char separator)
+      {
+         if (text.size() < pos + size || (pos > 0 && text[pos - 1] != separator))
+            return false;
+         auto result = std::from_chars(text.data() + pos, text.data() + pos + size, value);
+         return result.ec == std::errc {} && result.ptr == text.data() + pos + size;
+      };
+      if (!field(0, 4, ts.year, '\0') || !field(5, 2, ts.month, '-') || !field(8, 2, ts.day, '-'))
+         return false;
+      if (text.size() == 10)
+         return true;
+      if (!field(11, 2, ts.hour, ' ') || !field(14, 2, ts.minute, ':') || !field(17, 2, ts.second, ':'))
+         return false;
+      if (text.size() == 19)
+         return true;
+
+      // fraction in nanoseconds
+      if (text[19] != '.' || text.size() > 29 || text.size() == 20)
+         return false;
+      for (size_t pos = 20; pos < 29; pos++)
+      {
+         if (pos < text.size() && (text[pos] < '0' || text[pos] > '9'))
+            return false;
+         ts.fraction = ts.fraction * 10 + (pos < text.size() ? text[pos] - '0' : 0);
+      }
+      return true;
+   }
+
+   // numbers in a text column are sent as their shortest text
+   constexpr size_t max_number_text = 32;
+
+   size_t NumberToText(const json::value& jv, char* out)
+   {
+      std::to_chars_result result {};
+      if (jv.is_int64())
+         result = std::to_chars(out, out + max_number_text, jv.get_int64());
+      else if (jv.is_uint64())
+         result = std::to_chars(out, out + max_number_text, jv.get_uint64());
+      else
+         result = std::to_chars(out, out + max_number_text, jv.get_double());
+      return result.ptr - out;
+   }
+
+   // diagnostic record of a statement, row is the parameter set it applies to (1 based, 0 when none)
+   struct Diagnostic
+   {
+      SQLLEN      row {};
+      std::string message;
+   };
+
+   std::vector<Diagnostic> GetDiagnostics(SQLHSTMT hstmt)
+   {
+      std::vector<Diagnostic> diagnostics;
+      for (SQLSMALLINT rec = 1;; rec++)
+      {
+         SQLWCHAR    state[6] {};
+         SQLINTEGER  nativeError {};
+         SQLWCHAR    text[1024] {};
+         SQLSMALLINT textLength {};
+         if (!SQL_SUCCEEDED(SQLGetDiagRecW(SQL_HANDLE_STMT, hstmt, rec, state, &nativeError, text, static_cast<SQLSMALLINT>(std::size(text)), &textLength)))
+            break;
+
+         Diagnostic diagnostic;
+         SQLGetDiagField(SQL_HANDLE_STMT, hstmt, rec, SQL_DIAG_ROW_NUMBER, &diagnostic.row, 0, nullptr);
+         diagnostic.message = "[";
+         AppendUtf16ToUtf8(std::u16string_view(reinterpret_cast<const char16_t*>(state), 5), diagnostic.message);
+         diagnostic.message += "] ";
+         auto length = std::min<size_t>(std::max<SQLSMALLINT>(textLength, 0), std::size(text) - 1);
+         AppendUtf16ToUtf8(std::u16string_view(reinterpret_cast<const char16_t*>(text), length), diagnostic.message);
+         diagnostics.push_back(std::move(diagnostic));
+      }
+      return diagnostics;
+   }
+
+   // messages of row (1 based), all of them when the driver does not tell which row they are about
+   std::string RowMessage(const std::vector<Diagnostic>& diagnostics, SQLLEN row)
+   {
+      std::string message;
+      for (const auto& diagnostic: diagnostics)
+      {
+         if (diagnostic.row != row)
+            continue;
+         if (!message.empty())
+            message += "\n";
+         message += diagnostic.message;
+      }
+      if (message.empty() && row != 0)
+         return RowMessage(diagnostics, 0);
+      return message;
+   }
+}   // namespace
+
+BulkInsert::BulkInsert(nanodbc::connection& conn, std::string table, const CodePage& codePage, size_t batchSize) :
+   m_Table(std::move(table)),
+   m_CodePage(codePage),
+   m_BatchSize(std::max<size_t>(1, batchSize)),
+   m_Stmt(conn),
+   m_Schema(&GetTableColumns(conn, m_Table))
+{
+   // a base64 blob would be sent as text into its binary column
+   if (m_Schema->empty())
+      throw std::runtime_error(std::format("column types of table {} not available from the driver, blobs can't be told from text", m_Table));
+   m_Batch.reserve(m_BatchSize);
+}
+
+BulkInsert::BulkInsert(nanodbc::connection& conn, std::string table, Statement statement, std::vector<std::string> keyColumns, const CodePage& codePage, size_t batchSize) :
+   BulkInsert(conn, std::move(table), codePage, batchSize)
+{
+   m_Statement  = statement;
+   m_KeyColumns = std::move(keyColumns);
+}
+
+const char* BulkInsert::Verb() const
+{
+   switch (m_Statement)
+   {
+      case Statement::Update:
+         return "update";
+      case Statement::Delete:
+         return "delete from";
+      default:
+         return "insert into";
+   }
+}
+
+// blobs are base64 strings, or arrays of byte values in the older snapshots
+bool BulkInsert::IsBinaryColumn(json::string_view column) const
+{
+   auto it = m_Schema->find(std::string(column.data(), column.size()));
+   return it != m_Schema->end() && IsBinaryType(it->second.sqlType);
+}
+
+bool BulkInsert::SameColumns(const json::object& row) const
+{
+   if (row.size() != m_Columns.size())
+      return false;
+   size_t col {0};
+   for (const auto& member: row)
+   {
+      if (member.key() != m_Columns[col++])
+         return false;
+   }
+   return true;
+}
+
+void BulkInsert::Prepare(const json::object& row)
+{
+   m_Columns.clear();
+   m_ParamColumns.clear();
+   for (const auto& member: row)
+      m_Columns.emplace_back(member.key().data(), member.key().size());
+
+   auto isKey = [&](const std::string& column)
+   { return std::ranges::find(m_KeyColumns, column) != m_KeyColumns.end(); };
+   auto separate = [](std::string& list, const char* separator)
+   {
+      if (!list.empty())
+         list += separator;
+   };
+
+   std::string qry;
+   if (m_Statement == Statement::Insert)
+   {
+      std::string colList;
+      std::string params;
+      for (size_t col = 0; col < m_Columns.size(); col++)
+      {
+         separate(colList, ", ");
+         separate(params, ", ");
+         colList += m_Columns[col];
+         params += "?";
+         m_ParamColumns.push_back(col);
+      }
+      qry = std::format("insert into {} ({}) VALUES({});", m_Table, colList, params);
+   }
+   else
+   {
+      // SET parameters first, then the WHERE ones
+      std::string setList;
+      if (m_Statement == Statement::Update)
+      {
+         for (size_t col = 0; col < m_Columns.size(); col++)
+         {
+            if (isKey(m_Columns[col]))
+               continue;
+            separate(setList, ", ");
+            setList += m_Columns[col] + " = ?";
+            m_ParamColumns.push_back(col);
+         }
+      }
+      std::string where;
+      for (const auto& key: m_KeyColumns)
+      {
+         separate(where, " AND ");
+         where += key + " = ?";
+         m_ParamColumns.push_back(static_cast<size_t>(std::ranges::find(m_Columns, key) - m_Columns.begin()));
+      }
+      if (m_Statement == Statement::Update)
+         qry = std::format("update {} SET {} WHERE {};", m_Table, setList, where);
+      else
+         qry = std::format("delete from {} WHERE {};", m_Table, where);
+   }
+
+   SQLFreeStmt(m_Stmt.native_statement_handle(), SQL_RESET_PARAMS);
+   m_Stmt.prepare(qry);
+   m_Params.resize(m_ParamColumns.size());
+}
+
+void BulkInsert::Add(const json::object& row)
+{
+   auto index = m_RowCount++;
+   for (const auto& member: row)
+   {
+      if (!IsDbKind(member.value().kind()) && !(member.value().is_array() && IsBinaryColumn(member.key())))
+      {
+         m_Errors.push_back({index, json::serialize(row), std::format("invalid json kind for database, column {}", std::string_view(member.key().data(), member.key().size()))});
+         return;
+      }
+   }
+   for (const auto& key: m_KeyColumns)
+   {
+      if (!row.contains(key))
+      {
+         m_Errors.push_back({index, json::serialize(row), std::format("key column {} missing", key)});
+         return;
+      }
+   }
+   if (m_Statement == Statement::Update && row.size() == m_KeyColumns.size())
+   {
+      // nothing to set
+      m_Applied++;
+      return;
+   }
+
+   if (!SameColumns(row))
+   {
+      Flush();
+      Prepare(row);
+   }
+
+   m_Batch.push_back({index, json::object(row, json::storage_ptr(&m_Arena))});
+   if (m_Batch.size() >= m_BatchSize)
+      Flush();
+}
+
+void BulkInsert::Flush()
+{
+   if (m_Batch.empty())
+      return;
+   Execute();
+   m_Batch.clear();
+   m_Arena.release();
+}
+
+// fill and bind the parameter array of a column from the batch rows.
+// the C type is the one of the column when the values convert to it, integers in an integer column,
+// numbers in a floating point one, timestamp text in a date one... the driver then has nothing to parse.
+// for values which don't fit, or a column missing from the schema, it is the widest one the values need:
+// integer, then double, then text. blobs are decoded to bytes for a binary column
+void BulkInsert::BindParam(size_t paramIdx)
+{
+   auto& param = m_Params[paramIdx];
+   auto  col   = m_ParamColumns[paramIdx];
+   auto  rows  = m_Batch.size();
+
+   auto value = [&](size_t row) -> const json::value& { return m_Batch[row].row.begin()[col].value(); };
+
+   bool   allInteger {true};   // of the numbers
+   bool   allBigInt {true};
+   bool   hasNumber {};
+   bool   hasText {};
+   bool   allTimestamp {true};   // of the strings
+   bool   allBase64 {true};      // of the strings
+   bool   hasArray {};
+   size_t maxText {0};
+   size_t maxBytes {0};
+   for (size_t row = 0; row < rows; row++)
+   {
+      const auto&          jv = value(row);
+      SQL_TIMESTAMP_STRUCT ts;
+      if (jv.is_string())
+      {
+         hasText      = true;
+         maxText      = std::max<size_t>(maxText, CodePage::MaxFromUtf8Size(jv.get_string().size()));
+         maxBytes     = std::max<size_t>(maxBytes, MaxBase64DecodedSize(jv.get_string().size()));
+         allTimestamp = allTimestamp && ParseTimestamp(std::string_view(jv.get_string().data(), jv.get_string().size()), ts);
+         allBase64    = allBase64 && jv.get_string().size() % 4 == 0;
+      }
+      else if (jv.is_array())
+      {
+         hasArray = true;
+         maxBytes = std::max<size_t>(maxBytes, jv.get_array().size());
+      }
+      else if (jv.is_number())
+      {
+         hasNumber  = true;
+         allInteger = allInteger && FitsInteger(jv);
+         allBigInt  = allBigInt && FitsBigInt(jv);
+      }
+   }
+
+   auto      column = m_Schema->find(m_Columns[col]);
+   ParamKind kind   = hasText ? ParamKind::Text : (allInteger ? ParamKind::Integer : ParamKind::Double);
+   if (column != m_Schema->end())
+   {
+      switch (column->second.sqlType)
+      {
+         case SQL_BIGINT:
+            if (!hasText && allBigInt)
+               kind = ParamKind::BigInt;
+            break;
+
+         case SQL_NUMERIC:
+         case SQL_DECIMAL:
+            // exact digits, numbers are sent as their shortest text
+            kind = ParamKind::Text;
+            break;
+
+         default:
+            if (hasText && !hasNumber && !hasArray && allTimestamp && IsTimestampType(column->second.sqlType))
+               kind = ParamKind::Timestamp;
+            else if ((hasText || hasArray) && !hasNumber && allBase64 && IsBinaryType(column->second.sqlType))
+               kind = ParamKind::Binary;
+            break;
+      }
+   }
+
+   // arrays are only accepted by Add for binary columns
+   if (hasArray && kind != ParamKind::Binary)
+      throw std::runtime_error(std::format("column {} of {}: blobs mixed with other values", m_Columns[col], m_Table));
+
+   param.decimalDigits = 0;
+   switch (kind)
+   {
+      case ParamKind::Integer:
+         param.cType      = SQL_C_SLONG;
+         param.sqlType    = SQL_INTEGER;
+         param.columnSize = 10;
+         param.width      = sizeof(SQLINTEGER);
+         break;
+
+      case ParamKind::BigInt:
+         param.cType      = SQL_C_SBIGINT;
+         param.sqlType    = SQL_BIGINT;
+         param.columnSize = 19;
+         param.width      = sizeof(SQLBIGINT);
+         break;
+
+      case ParamKind::Double:
+         param.cType      = SQL_C_DOUBLE;
+         param.sqlType    = SQL_DOUBLE;
+         param.columnSize = 15;
+         param.width      = sizeof(double);
+         break;
+
+      case ParamKind::Text:
+         param.cType = SQL_C_CHAR;
+         param.width = std::max(maxText, hasNumber ? max_number_text : 0) + 1;
+         break;
+
+      case ParamKind::Timestamp:
+         param.cType         = SQL_C_TYPE_TIMESTAMP;
+         param.sqlType       = SQL_TYPE_TIMESTAMP;
+         param.columnSize    = 23;
+         param.decimalDigits = 3;
+         param.width         = sizeof(SQL_TIMESTAMP_STRUCT);
+         break;
+
+      case ParamKind::Binary:
+         param.cType = SQL_C_BINARY;
+         param.width = std::max<size_t>(maxBytes, 1);
+         break;
+   }
+
+   param.data.resize(rows * param.width);
+   param.indicators.resize(rows);
+   size_t longest {1};
+   for (size_t row = 0; row < rows; row++)
+   {
+      const auto& jv   = value(row);
+      char*       slot = param.data.data() + row * param.width;
+      if (jv.is_null())
+      {
+         param.indicators[row] = SQL_NULL_DATA;
+         continue;
+      }
+
+      switch (kind)
+      {
+         case ParamKind::Integer:
+         {
+            auto integer = jv.to_number<SQLINTEGER>();
+            std::memcpy(slot, &integer, sizeof(integer));
+            param.indicators[row] = sizeof(integer);
+            break;
+         }
+
+         case ParamKind::BigInt:
+         {
+            auto integer = jv.to_number<SQLBIGINT>();
+            std::memcpy(slot, &integer, sizeof(integer));
+            param.indicators[row] = sizeof(integer);
+            break;
+         }
+
+         case ParamKind::Double:
+         {
+            auto real = jv.to_number<double>();
+            std::memcpy(slot, &real, sizeof(real));
+            param.indicators[row] = sizeof(real);
+            break;
+         }
+
+         case ParamKind::Text:
+         {
+            size_t size {};
+            if (jv.is_string())
+               size = m_CodePage.FromUtf8(std::string_view(jv.get_string().data(), jv.get_string().size()), slot).written;
+            else
+               size = NumberToText(jv, slot);
+            slot[size]            = '\0';
+            param.indicators[row] = static_cast<SQLLEN>(size);
+            longest               = std::max(longest, size);
+            break;
+         }
+
+         case ParamKind::Timestamp:
+         {
+            // only strings reach here, all of them parsed when the kind was chosen
+            SQL_TIMESTAMP_STRUCT ts;
+            if (!jv.is_string() || !ParseTimestamp(std::string_view(jv.get_string().data(), jv.get_string().size()), ts))
+               throw std::runtime_error(std::format("column {} of {}: invalid timestamp in row {}", m_Columns[col], m_Table, m_Batch[row].index));
+            std::memcpy(slot, &ts, sizeof(ts));
+            param.indicators[row] = sizeof(ts);
+            break;
+         }
+
+         case ParamKind::Binary:
+         {
+            size_t size {};
+            if (jv.is_string())
+            {
+               auto decoded = Base64Decode(std::string_view(jv.get_string().data(), jv.get_string().size()), slot);
+               if (!decoded)
+                  throw std::runtime_error(std::format("column {} of {}: invalid base64 value in row {}", m_Columns[col], m_Table, m_Batch[row].index));
+               size = *decoded;
+            }
+            else
+            {
+               for (const auto& byte: jv.get_array())
+                  slot[size++] = static_cast<char>(byte.to_number<std::uint8_t>());
+            }
+            param.indicators[row] = static_cast<SQLLEN>(size);
+            longest               = std::max(longest, size);
+            break;
+         }
+      }
+   }
+
+   if (kind == ParamKind::Text)
+   {
+      // access TEXT columns hold up to 255 characters, longer ones are MEMO
+      param.columnSize = longest;
+      param.sqlType    = longest > 255 ? SQL_LONGVARCHAR : SQL_VARCHAR;
+   }
+   bool variable = kind == ParamKind::Text || kind == ParamKind::Binary;
+   if (column != m_Schema->end())
+   {
+      // the driver converts from the C type to the column one
+      param.sqlType       = column->second.sqlType;
+      param.columnSize    = std::max<SQLULEN>(column->second.columnSize, variable ? longest : 0);
+      param.decimalDigits = column->second.decimalDigits;
+   }
+
+   auto rc = SQLBindParameter(m_Stmt.native_statement_handle(), static_cast<SQLUSMALLINT>(paramIdx + 1), SQL_PARAM_INPUT, param.cType, param.sqlType,
+                              param.columnSize, param.decimalDigits, param.data.data(), static_cast<SQLLEN>(param.width), param.indicators.data());
+   if (!SQL_SUCCEEDED(rc))
+      throw std::runtime_error(std::format("binding column {} of {} failed: {}", m_Columns[col], m_Table, RowMessage(GetDiagnostics(m_Stmt.native_statement_handle()), 0)));
+}
+
+void BulkInsert::Execute()
+{
+   auto hstmt = m_Stmt.native_statement_handle();
+   auto rows  = m_Batch.size();
+   for (size_t param = 0; param < m_ParamColumns.size(); param++)
+      BindParam(param);
+
+   m_Status.assign(rows, SQL_PARAM_UNUSED);
+   m_Processed = 0;
+   SQLSetStmtAttr(hstmt, SQL_ATTR_PARAM_BIND_TYPE, reinterpret_cast<SQLPOINTER>(SQL_PARAM_BIND_BY_COLUMN), 0);
+   SQLSetStmtAttr(hstmt, SQL_ATTR_PARAM_STATUS_PTR, m_Status.data(), 0);
+   SQLSetStmtAttr(hstmt, SQL_ATTR_PARAMS_PROCESSED_PTR, &m_Processed, 0);
+   if (!SQL_SUCCEEDED(SQLSetStmtAttr(hstmt, SQL_ATTR_PARAMSET_SIZE, reinterpret_cast<SQLPOINTER>(rows), 0)))
+      throw std::runtime_error(std::format("the driver does not accept {} parameter sets, use a smaller batch", rows));
+
+   auto rc = SQLExecute(hstmt);
+   if (rc == SQL_SUCCESS)
+   {
+      m_Applied += rows;
+      return;
+   }
+   if (rc == SQL_NO_DATA)
+   {
+      // update or delete matching no row
+      return;
+   }
+
+   auto diagnostics = GetDiagnostics(hstmt);
+   auto rowErrors   = std::ranges::count(m_Status, SQLUSMALLINT {SQL_PARAM_ERROR});
+   if (rc != SQL_SUCCESS_WITH_INFO && (rc != SQL_ERROR || rowErrors == 0))
+      throw std::runtime_error(std::format("{} {} failed: {}", Verb(), m_Table, RowMessage(diagnostics, 0)));
+   if (rowErrors == 0)
+   {
+      // only warnings
+      m_Applied += rows;
+      return;
+   }
+
+   for (size_t row = 0; row < rows; row++)
+   {
+      switch (m_Status[row])
+      {
+         case SQL_PARAM_SUCCESS:
+         case SQL_PARAM_SUCCESS_WITH_INFO:
+            m_Applied++;
+            break;
+
+         case SQL_PARAM_ERROR:
+            m_Errors.push_back({m_Batch[row].index, json::serialize(m_Batch[row].row), RowMessage(diagnostics, static_cast<SQLLEN>(row + 1))});
+            break;
+
+         default:
+            m_Errors.push_back({m_Batch[row].index, json::serialize(m_Batch[row].row), "not processed, the driver stopped at a previous error"});
+            break;
+      }
+   }
+}
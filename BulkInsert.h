@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <boost/json.hpp>
+#include <nanodbc/nanodbc.h>
+
+#include "CodePage.h"
+#include "ColumnSchema.h"
+#include "Platform.h"
+
+// rows sent per SQLExecute when nothing is specified
+constexpr size_t default_insert_batch = 1000;
+
+// inserts rows into one table with a prepared, parameterized INSERT.
+// rows are buffered and sent batchSize at a time as arrays of parameters (SQL_ATTR_PARAMSET_SIZE),
+// the statement is only prepared again when the set of columns changes.
+// parameter types follow the column types (see ColumnSchema.h) when the json values of the batch
+// convert to them, they are inferred from the values otherwise. blobs (base64 strings, or arrays
+// of bytes) are decoded for binary columns, a table whose column types are unknown is refused.
+// rows the driver rejects are reported by Errors(), the other rows are inserted.
+// the same batches can UPDATE or DELETE the rows matching the key columns of each row instead
+class BulkInsert
+{
+public:
+   enum class Statement
+   {
+      Insert,
+      Update,   // the columns which are not key columns
+      Delete    // only the key columns are used
+   };
+
+   struct RowError
+   {
+      size_t      row;       // index of the row, in the order given to Add
+      std::string text;      // the row as json
+      std::string message;   // from the driver
+   };
+
+private:
+   struct BatchRow
+   {
+      size_t              index;
+      boost::json::object row;
+   };
+
+   // column-wise parameter array
+   struct Param
+   {
+      SQLSMALLINT         cType {};
+      SQLSMALLINT         sqlType {};
+      SQLULEN             columnSize {};
+      SQLSMALLINT         decimalDigits {};
+      size_t              width {};   // bytes per row in data
+      std::vector<char>   data;
+      std::vector<SQLLEN> indicators;
+   };
+
+   std::string                     m_Table;
+   Statement                       m_Statement {Statement::Insert};
+   std::vector<std::string>        m_KeyColumns;
+   const CodePage&                 m_CodePage;
+   size_t                          m_BatchSize;
+   nanodbc::statement              m_Stmt;
+   const TableColumns*             m_Schema;
+   std::vector<std::string>        m_Columns;        // of the rows of the prepared statement
+   std::vector<size_t>             m_ParamColumns;   // index in m_Columns of each parameter
+   boost::json::monotonic_resource m_Arena;     // batch rows, released once sent
+   std::vector<BatchRow>           m_Batch;
+   std::vector<Param>              m_Params;
+   std::vector<SQLUSMALLINT>       m_Status;    // SQL_ATTR_PARAM_STATUS_PTR
+   SQLULEN                         m_Processed {};
+   size_t                          m_RowCount {};
+   size_t                          m_Applied {};
+   std::vector<RowError>           m_Errors;
+
+   bool        IsBinaryColumn(boost::json::string_view column) const;
+   bool        SameColumns(const boost::json::object& row) const;
+   void        Prepare(const boost::json::object& row);
+   void        BindParam(size_t param);
+   void        Execute();
+   const char* Verb() const;
+
+public:
+   BulkInsert(nanodbc::connection& conn, std::string table, const CodePage& codePage, size_t batchSize = default_insert_batch);
+   // update or delete, rows without all the key columns are reported by Errors()
+   BulkInsert(nanodbc::connection& conn, std::string table, Statement statement, std::vector<std::string> keyColumns, const CodePage& codePage, size_t batchSize = default_insert_batch);
+
+   BulkInsert(const BulkInsert&)            = delete;
+   BulkInsert& operator=(const BulkInsert&) = delete;
+
+   void Add(const boost::json::object& row);
+
+   // send the buffered rows, to be called before committing
+   void Flush();
+
+   size_t                       Applied() const { return m_Applied; }   // rows inserted, updated or deleted
+   const std::vector<RowError>& Errors() const { return m_Errors; }
+};
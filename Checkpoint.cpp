@@ -0,0 +1,126 @@
+#include "Checkpoint.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <stdexcept>
+
+#include "PrettyPrint.h"
+
+namespace json = boost::json;
+
+namespace
+{
+   constexpr size_t hashed_block = 64 * 1024;   // at each end of the snapshot
+
+   // FNV-1a of the first and last blocks, a rewritten snapshot of the same size differs there
+   std::uint64_t SnapshotHash(std::string_view text)
+   {
+      std::uint64_t hash = 14695981039346656037ull;
+      auto          add  = [&](std::string_view block)
+      {
+         for (auto c: block)
+         {
+            hash ^= static_cast<std::uint8_t>(c);
+            hash *= 1099511628211ull;
+         }
+      };
+      add(text.substr(0, hashed_block));
+      add(text.substr(text.size() - std::min(text.size(), hashed_block)));
+      return hash;
+   }
+}   // namespace
+
+Checkpoint::Checkpoint(std::string filename, const std::string& snapshot, std::string_view snapshotText) :
+   m_Filename(std::move(filename))
+{
+   json::object identity;
+   identity["snapshot"] = snapshot;
+   identity["size"]     = snapshotText.size();
+   identity["modified"] = std::filesystem::last_write_time(snapshot).time_since_epoch().count();
+   identity["hash"]     = SnapshotHash(snapshotText);
+
+   std::ifstream input(m_Filename, std::ios::binary);
+   if (input)
+   {
+      m_State = json::parse(std::string((std::istreambuf_iterator<char>(input)),
+                                        std::istreambuf_iterator<char>()))
+                   .as_object();
+      for (const auto& member: identity)
+      {
+         auto saved = m_State.if_contains(member.key());
+         if (!saved || *saved != member.value())
+            throw std::runtime_error(std::format("checkpoint {} was written for snapshot {} as it was then, remove it to start over", m_Filename, json::serialize(m_State.at("snapshot"))));
+      }
+      m_State["resumed"] = true;
+      return;
+   }
+
+   m_State            = std::move(identity);
+   m_State["deleted"] = false;
+   m_State["tables"]   = json::object {};
+}
+
+bool Checkpoint::Resumed() const
+{
+   std::lock_guard lock(m_Mutex);
+   return m_State.contains("resumed");
+}
+
+bool Checkpoint::Deleted() const
+{
+   std::lock_guard lock(m_Mutex);
+   return m_State.at("deleted").as_bool();
+}
+
+void Checkpoint::SetDeleted()
+{
+   std::lock_guard lock(m_Mutex);
+   m_State["deleted"] = true;
+   Save();
+}
+
+size_t Checkpoint::Rows(const std::string& table) const
+{
+   std::lock_guard lock(m_Mutex);
+   auto            progress = m_State.at("tables").as_object().if_contains(table);
+   return progress ? progress->at("rows").to_number<size_t>() : 0;
+}
+
+bool Checkpoint::Done(const std::string& table) const
+{
+   std::lock_guard lock(m_Mutex);
+   auto            progress = m_State.at("tables").as_object().if_contains(table);
+   return progress && progress->at("done").as_bool();
+}
+
+void Checkpoint::Commit(const std::string& table, size_t rows, bool done)
+{
+   std::lock_guard lock(m_Mutex);
+   m_State["tables"].as_object()[table] = {{"rows", rows}, {"done", done}};
+   Save();
+}
+
+void Checkpoint::Remove()
+{
+   std::lock_guard lock(m_Mutex);
+   std::filesystem::remove(m_Filename);
+}
+
+// written aside then renamed, a crash never leaves half a checkpoint
+void Checkpoint::Save()
+{
+   auto state = m_State;
+   state.erase("resumed");
+
+   auto temporary = m_Filename + ".tmp";
+   {
+      std::ofstream output(temporary, std::ios::binary | std::ios::trunc);
+      pretty_print(output, state);
+      if (!output.flush())
+         throw std::runtime_error(std::format("can't write checkpoint {}", temporary));
+   }
+   std::filesystem::rename(temporary, m_Filename);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+#include <boost/json.hpp>
+
+// progress of an import saved in a small json file after each commit, a failed import
+// run again with the same checkpoint file resumes where it stopped:
+// {
+//   "snapshot" : "name", "size" : bytes, "modified" : time, "hash" : first and last blocks, "deleted" : true,
+//   "tables" : { "table" : { "rows" : committed rows, "done" : false } }
+// }
+// rows are counted in the snapshot order, the snapshot must not change between the runs:
+// it is a file, recognized from its size, its modification time and a hash of its ends.
+// tables are imported concurrently, the file is rewritten as a whole, each commit at a time.
+// it is saved once the database transaction is committed, not within it: a crash between the two
+// leaves the last interval committed but not recorded, the resumed import sends its rows again
+// (rejected as duplicates by a table with a unique key, the import then has to start over)
+class Checkpoint
+{
+   std::string         m_Filename;
+   mutable std::mutex  m_Mutex;
+   boost::json::object m_State;
+
+   void Save();
+
+public:
+   // loads the file when it exists, throws when it was written for another snapshot
+   Checkpoint(std::string filename, const std::string& snapshot, std::string_view snapshotText);
+
+   bool Resumed() const;   // loaded from the file
+
+   // the tables were emptied before the import
+   bool Deleted() const;
+   void SetDeleted();
+
+   size_t Rows(const std::string& table) const;   // committed rows of the table
+   bool   Done(const std::string& table) const;
+   void   Commit(const std::string& table, size_t rows, bool done);
+
+   // the import is complete, the next one starts over
+   void Remove();
+};
@@ -0,0 +1,56 @@
+#include "CmdLine.h"
+
+#include <format>
+#include <stdexcept>
+
+CmdLine::CmdLine(int argc, char** argv)
+{
+   for (int i = 1; i < argc; i++)
+   {
+      std::string arg {argv[i]};
+      if (arg.starts_with("--"))
+      {
+         auto equal = arg.find('=');
+         if (equal == std::string::npos)
+            m_Options.emplace_back(arg.substr(2), std::string {});
+         else
+            m_Options.emplace_back(arg.substr(2, equal - 2), arg.substr(equal + 1));
+      }
+      else
+      {
+         m_Positional.push_back(std::move(arg));
+      }
+   }
+}
+
+bool CmdLine::Has(const std::string& name) const
+{
+   for (const auto& option: m_Options)
+      if (option.first == name)
+         return true;
+   return false;
+}
+
+std::string CmdLine::Get(const std::string& name, const std::string& defaultValue) const
+{
+   // last one wins, so options can be overriden at the end of a command line
+   for (auto it = m_Options.rbegin(); it != m_Options.rend(); ++it)
+      if (it->first == name)
+         return it->second;
+   return defaultValue;
+}
+
+size_t CmdLine::GetSize(const std::string& name, size_t defaultValue) const
+{
+   auto value = Get(name);
+   if (value.empty())
+      return defaultValue;
+   try
+   {
+      return std::stoull(value);
+   }
+   catch (const std::exception&)
+   {
+      throw std::runtime_error(std::format("invalid numeric value for --{}: [{}]", name, value));
+   }
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+// minimal command line parsing shared by the tools
+// positional arguments are kept in order, options are --name or --name=value
+class CmdLine
+{
+   std::vector<std::string>                         m_Positional;
+   std::vector<std::pair<std::string, std::string>> m_Options;
+
+public:
+   CmdLine(int argc, char** argv);
+
+   const std::vector<std::string>& Positional() const { return m_Positional; }
+
+   bool        Has(const std::string& name) const;
+   std::string Get(const std::string& name, const std::string& defaultValue = {}) const;
+   size_t      GetSize(const std::string& name, size_t defaultValue) const;
+};
@@ -0,0 +1,181 @@
+#include "CodePage.h"
+
+#include <cctype>
+#include <cstring>
+#include <format>
+#include <stdexcept>
+#include <utility>
+
+#if defined(_WIN32)
+   #include <windows.h>
+#endif
+
+namespace
+{
+   constexpr std::array<char16_t, 128> Latin1High()
+   {
+      std::array<char16_t, 128> high {};
+      for (unsigned idx = 0; idx < 128; idx++)
+         high[idx] = static_cast<char16_t>(0x80 + idx);
+      return high;
+   }
+
+   // the 5 unassigned characters map to the C1 control like windows does
+   constexpr CodePage cp1252("windows-1252", {
+      0x20ac, 0x0081, 0x201a, 0x0192, 0x201e, 0x2026, 0x2020, 0x2021, 0x02c6, 0x2030, 0x0160, 0x2039, 0x0152, 0x008d, 0x017d, 0x008f,
+      0x0090, 0x2018, 0x2019, 0x201c, 0x201d, 0x2022, 0x2013, 0x2014, 0x02dc, 0x2122, 0x0161, 0x203a, 0x0153, 0x009d, 0x017e, 0x0178,
+      0x00a0, 0x00a1, 0x00a2, 0x00a3, 0x00a4, 0x00a5, 0x00a6, 0x00a7, 0x00a8, 0x00a9, 0x00aa, 0x00ab, 0x00ac, 0x00ad, 0x00ae, 0x00af,
+      0x00b0, 0x00b1, 0x00b2, 0x00b3, 0x00b4, 0x00b5, 0x00b6, 0x00b7, 0x00b8, 0x00b9, 0x00ba, 0x00bb, 0x00bc, 0x00bd, 0x00be, 0x00bf,
+      0x00c0, 0x00c1, 0x00c2, 0x00c3, 0x00c4, 0x00c5, 0x00c6, 0x00c7, 0x00c8, 0x00c9, 0x00ca, 0x00cb, 0x00cc, 0x00cd, 0x00ce, 0x00cf,
+      0x00d0, 0x00d1, 0x00d2, 0x00d3, 0x00d4, 0x00d5, 0x00d6, 0x00d7, 0x00d8, 0x00d9, 0x00da, 0x00db, 0x00dc, 0x00dd, 0x00de, 0x00df,
+      0x00e0, 0x00e1, 0x00e2, 0x00e3, 0x00e4, 0x00e5, 0x00e6, 0x00e7, 0x00e8, 0x00e9, 0x00ea, 0x00eb, 0x00ec, 0x00ed, 0x00ee, 0x00ef,
+      0x00f0, 0x00f1, 0x00f2, 0x00f3, 0x00f4, 0x00f5, 0x00f6, 0x00f7, 0x00f8, 0x00f9, 0x00fa, 0x00fb, 0x00fc, 0x00fd, 0x00fe, 0x00ff});
+
+   // the console in Québec
+   constexpr CodePage cp850("ibm-850", {
+      0x00c7, 0x00fc, 0x00e9, 0x00e2, 0x00e4, 0x00e0, 0x00e5, 0x00e7, 0x00ea, 0x00eb, 0x00e8, 0x00ef, 0x00ee, 0x00ec, 0x00c4, 0x00c5,
+      0x00c9, 0x00e6, 0x00c6, 0x00f4, 0x00f6, 0x00f2, 0x00fb, 0x00f9, 0x00ff, 0x00d6, 0x00dc, 0x00f8, 0x00a3, 0x00d8, 0x00d7, 0x0192,
+      0x00e1, 0x00ed, 0x00f3, 0x00fa, 0x00f1, 0x00d1, 0x00aa, 0x00ba, 0x00bf, 0x00ae, 0x00ac, 0x00bd, 0x00bc, 0x00a1, 0x00ab, 0x00bb,
+      0x2591, 0x2592, 0x2593, 0x2502, 0x2524, 0x00c1, 0x00c2, 0x00c0, 0x00a9, 0x2563, 0x2551, 0x2557, 0x255d, 0x00a2, 0x00a5, 0x2510,
+      0x2514, 0x2534, 0x252c, 0x251c, 0x2500, 0x253c, 0x00e3, 0x00c3, 0x255a, 0x2554, 0x2569, 0x2566, 0x2560, 0x2550, 0x256c, 0x00a4,
+      0x00f0, 0x00d0, 0x00ca, 0x00cb, 0x00c8, 0x0131, 0x00cd, 0x00ce, 0x00cf, 0x2518, 0x250c, 0x2588, 0x2584, 0x00a6, 0x00cc, 0x2580,
+      0x00d3, 0x00df, 0x00d4, 0x00d2, 0x00f5, 0x00d5, 0x00b5, 0x00fe, 0x00de, 0x00da, 0x00db, 0x00d9, 0x00fd, 0x00dd, 0x00af, 0x00b4,
+      0x00ad, 0x00b1, 0x2017, 0x00be, 0x00b6, 0x00a7, 0x00f7, 0x00b8, 0x00b0, 0x00a8, 0x00b7, 0x00b9, 0x00b3, 0x00b2, 0x25a0, 0x00a0});
+
+   constexpr CodePage iso8859_1("iso-8859-1", Latin1High());
+
+   // latin-1 with the euro and a few french and finnish letters
+   constexpr CodePage iso8859_15("iso-8859-15", {
+      0x0080, 0x0081, 0x0082, 0x0083, 0x0084, 0x0085, 0x0086, 0x0087, 0x0088, 0x0089, 0x008a, 0x008b, 0x008c, 0x008d, 0x008e, 0x008f,
+      0x0090, 0x0091, 0x0092, 0x0093, 0x0094, 0x0095, 0x0096, 0x0097, 0x0098, 0x0099, 0x009a, 0x009b, 0x009c, 0x009d, 0x009e, 0x009f,
+      0x00a0, 0x00a1, 0x00a2, 0x00a3, 0x20ac, 0x00a5, 0x0160, 0x00a7, 0x0161, 0x00a9, 0x00aa, 0x00ab, 0x00ac, 0x00ad, 0x00ae, 0x00af,
+      0x00b0, 0x00b1, 0x00b2, 0x00b3, 0x017d, 0x00b5, 0x00b6, 0x00b7, 0x017e, 0x00b9, 0x00ba, 0x00bb, 0x0152, 0x0153, 0x0178, 0x00bf,
+      0x00c0, 0x00c1, 0x00c2, 0x00c3, 0x00c4, 0x00c5, 0x00c6, 0x00c7, 0x00c8, 0x00c9, 0x00ca, 0x00cb, 0x00cc, 0x00cd, 0x00ce, 0x00cf,
+      0x00d0, 0x00d1, 0x00d2, 0x00d3, 0x00d4, 0x00d5, 0x00d6, 0x00d7, 0x00d8, 0x00d9, 0x00da, 0x00db, 0x00dc, 0x00dd, 0x00de, 0x00df,
+      0x00e0, 0x00e1, 0x00e2, 0x00e3, 0x00e4, 0x00e5, 0x00e6, 0x00e7, 0x00e8, 0x00e9, 0x00ea, 0x00eb, 0x00ec, 0x00ed, 0x00ee, 0x00ef,
+      0x00f0, 0x00f1, 0x00f2, 0x00f3, 0x00f4, 0x00f5, 0x00f6, 0x00f7, 0x00f8, 0x00f9, 0x00fa, 0x00fb, 0x00fc, 0x00fd, 0x00fe, 0x00ff});
+
+   static_assert(cp1252.FromCodePoint(0x20ac) == '\x80' && cp850.FromCodePoint(0xe9) == '\x82' && iso8859_15.FromCodePoint(0x20ac) == '\xa4');
+   static_assert(iso8859_1.FromCodePoint(0x20ac) == '?');
+
+   constexpr std::pair<std::string_view, const CodePage*> codePageNames[] = {
+      {"1252", &cp1252},
+      {"cp1252", &cp1252},
+      {"windows-1252", &cp1252},
+      {"850", &cp850},
+      {"cp850", &cp850},
+      {"ibm-850", &cp850},
+      {"28591", &iso8859_1},
+      {"iso-8859-1", &iso8859_1},
+      {"latin1", &iso8859_1},
+      {"28605", &iso8859_15},
+      {"iso-8859-15", &iso8859_15},
+      {"latin9", &iso8859_15},
+   };
+
+   bool SameName(std::string_view lhs, std::string_view rhs)
+   {
+      return std::ranges::equal(lhs, rhs, [](char l, char r) { return std::tolower(static_cast<unsigned char>(l)) == std::tolower(static_cast<unsigned char>(r)); });
+   }
+}   // namespace
+
+TranscodeResult CodePage::ToUtf8(std::string_view text, char* out) const
+{
+   const char* p     = text.data();
+   const char* end   = p + text.size();
+   char*       start = out;
+   while (p < end)
+   {
+      auto ascii = AsciiPrefix(p, end);
+      std::memcpy(out, p, ascii);
+      out += ascii;
+      p += ascii;
+      if (p == end)
+         break;
+      // copying the 3 bytes is fine, the buffer has room for 3 per remaining character
+      const auto& utf8 = m_ToUtf8[static_cast<unsigned char>(*p++) - 0x80];
+      std::memcpy(out, utf8.bytes, sizeof(utf8.bytes));
+      out += utf8.size;
+   }
+   return {static_cast<size_t>(out - start), 0};
+}
+
+TranscodeResult CodePage::FromUtf8(std::string_view utf8Str, char* out) const
+{
+   TranscodeResult result;
+   const char*     p     = utf8Str.data();
+   const char*     end   = p + utf8Str.size();
+   char*           start = out;
+   while (p < end)
+   {
+      auto ascii = AsciiPrefix(p, end);
+      std::memcpy(out, p, ascii);
+      out += ascii;
+      p += ascii;
+      if (p == end)
+         break;
+      auto c = FromCodePoint(DecodeUtf8(p, end));
+      if (c == '?')
+         result.unmappable++;
+      *out++ = c;
+   }
+   result.written = out - start;
+   return result;
+}
+
+TranscodeResult CodePage::AppendToUtf8(std::string_view text, std::string& out) const
+{
+   auto size = out.size();
+   out.resize(size + MaxToUtf8Size(text.size()));
+   auto result = ToUtf8(text, out.data() + size);
+   out.resize(size + result.written);
+   return result;
+}
+
+TranscodeResult CodePage::AppendFromUtf8(std::string_view utf8Str, std::string& out) const
+{
+   auto size = out.size();
+   out.resize(size + MaxFromUtf8Size(utf8Str.size()));
+   auto result = FromUtf8(utf8Str, out.data() + size);
+   out.resize(size + result.written);
+   return result;
+}
+
+const CodePage* CodePage::Find(std::string_view name)
+{
+   for (const auto& [codePageName, codePage]: codePageNames)
+   {
+      if (SameName(codePageName, name))
+         return codePage;
+   }
+   return nullptr;
+}
+
+const CodePage& CodePage::Get(std::string_view name)
+{
+   if (auto codePage = Find(name))
+      return *codePage;
+   throw std::runtime_error(std::format("unknown code page: {}", name));
+}
+
+const CodePage& CodePage::Cp1252()
+{
+   return cp1252;
+}
+
+std::string ToConsole(std::string_view utf8Str)
+{
+#if defined(_WIN32)
+   // the console is using codepage defined at:
+   // HKEY_LOCAL_MACHINE\SYSTEM\CurrentControlSet\Control\Nls\CodePage\OEMCP
+   // which happens to be 850 in North America, unless switched to utf-8 (see platform.cpp)
+   static const CodePage* console = CodePage::Find(std::to_string(GetConsoleOutputCP()));
+   if (console)
+   {
+      std::string text;
+      console->AppendFromUtf8(utf8Str, text);
+      return text;
+   }
+#endif
+   return std::string(utf8Str);
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "utf8Conversion.h"
+
+// single byte code page: ascii plus 128 characters given by their unicode code point.
+// the utf-8 encode and decode tables are generated at compile time,
+// code pages are selected by name at run time, see Find
+class CodePage
+{
+   struct Utf8Char
+   {
+      char         bytes[3];
+      std::uint8_t size;
+   };
+
+   struct Reverse
+   {
+      char16_t codePoint;
+      char     c;
+   };
+
+   std::string_view          m_Name;
+   std::array<Utf8Char, 128> m_ToUtf8 {};
+   std::array<Reverse, 128>  m_FromUtf8 {};   // sorted by code point
+
+public:
+   // high holds the code points of characters 0x80..0xff, all below 0x10000
+   constexpr CodePage(std::string_view name, const std::array<char16_t, 128>& high) :
+      m_Name(name)
+   {
+      for (unsigned idx = 0; idx < 128; idx++)
+      {
+         char32_t cp = high[idx];
+         if (cp < 0x800)
+            m_ToUtf8[idx] = {{static_cast<char>(0xc0 | (cp >> 6)), static_cast<char>(0x80 | (cp & 0x3f))}, 2};
+         else
+            m_ToUtf8[idx] = {{static_cast<char>(0xe0 | (cp >> 12)), static_cast<char>(0x80 | ((cp >> 6) & 0x3f)), static_cast<char>(0x80 | (cp & 0x3f))}, 3};
+         m_FromUtf8[idx] = {high[idx], static_cast<char>(0x80 + idx)};
+      }
+      std::sort(m_FromUtf8.begin(), m_FromUtf8.end(), [](const Reverse& lhs, const Reverse& rhs) { return lhs.codePoint < rhs.codePoint; });
+   }
+
+   std::string_view Name() const { return m_Name; }
+
+   // code page character of a code point, '?' when there is none
+   constexpr char FromCodePoint(char32_t cp) const
+   {
+      if (cp < 0x80)
+         return static_cast<char>(cp);
+      auto it = std::lower_bound(m_FromUtf8.begin(), m_FromUtf8.end(), cp, [](const Reverse& entry, char32_t value) { return entry.codePoint < value; });
+      return it != m_FromUtf8.end() && it->codePoint == cp ? it->c : '?';
+   }
+
+   // output buffer size needed for an input of size bytes
+   static constexpr size_t MaxToUtf8Size(size_t size) { return size * 3; }
+   static constexpr size_t MaxFromUtf8Size(size_t size) { return size; }
+
+   // same contract as the utf8Conversion functions, unmappable characters become '?'
+   TranscodeResult ToUtf8(std::string_view text, char* out) const;
+   TranscodeResult FromUtf8(std::string_view utf8Str, char* out) const;
+   TranscodeResult AppendToUtf8(std::string_view text, std::string& out) const;
+   TranscodeResult AppendFromUtf8(std::string_view utf8Str, std::string& out) const;
+
+   // by name or number, case insensitive: "1252", "cp1252", "windows-1252", "850", "iso-8859-1", "latin9"...
+   // nullptr when unknown
+   static const CodePage* Find(std::string_view name);
+
+   // throws when unknown
+   static const CodePage& Get(std::string_view name);
+
+   // MsAccess text
+   static const CodePage& Cp1252();
+};
+
+// utf-8 text as the console shows it, unchanged when the console uses utf-8
+std::string ToConsole(std::string_view utf8Str);
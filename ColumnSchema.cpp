@@ -0,0 +1,57 @@
+#include "ColumnSchema.h"
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+
+#include "utf8Conversion.h"
+
+namespace
+{
+   TableColumns ReadTableColumns(nanodbc::connection& conn, const std::string& table)
+   {
+      TableColumns columns;
+
+      nanodbc::statement stmt(conn);
+      auto               hstmt = stmt.native_statement_handle();
+
+      // table names are ascii
+      std::basic_string<SQLWCHAR> name(table.begin(), table.end());
+      if (!SQL_SUCCEEDED(SQLColumnsW(hstmt, nullptr, 0, nullptr, 0, name.data(), SQL_NTS, nullptr, 0)))
+         return columns;
+
+      // COLUMN_NAME, DATA_TYPE, COLUMN_SIZE and DECIMAL_DIGITS of the SQLColumns result set
+      while (SQL_SUCCEEDED(SQLFetch(hstmt)))
+      {
+         SQLWCHAR    columnName[256] {};
+         SQLLEN      nameLength {};
+         SQLSMALLINT dataType {};
+         SQLINTEGER  columnSize {};
+         SQLSMALLINT decimalDigits {};
+         SQLLEN      indicator {};
+         if (!SQL_SUCCEEDED(SQLGetData(hstmt, 4, SQL_C_WCHAR, columnName, sizeof(columnName), &nameLength)) || nameLength <= 0)
+            continue;
+         SQLGetData(hstmt, 5, SQL_C_SSHORT, &dataType, 0, &indicator);
+         SQLGetData(hstmt, 7, SQL_C_SLONG, &columnSize, 0, &indicator);
+         if (!SQL_SUCCEEDED(SQLGetData(hstmt, 9, SQL_C_SSHORT, &decimalDigits, 0, &indicator)) || indicator == SQL_NULL_DATA)
+            decimalDigits = 0;
+
+         std::string key;
+         AppendUtf16ToUtf8(std::u16string_view(reinterpret_cast<const char16_t*>(columnName)), key);
+         columns[key] = {dataType, static_cast<SQLULEN>(std::max<SQLINTEGER>(columnSize, 0)), decimalDigits};
+      }
+      return columns;
+   }
+}   // namespace
+
+const TableColumns& GetTableColumns(nanodbc::connection& conn, const std::string& table)
+{
+   static std::mutex                          mutex;
+   static std::map<std::string, TableColumns> cache;   // references stay valid as tables are added
+
+   std::lock_guard lock(mutex);
+   auto            it = cache.find(table);
+   if (it == cache.end())
+      it = cache.emplace(table, ReadTableColumns(conn, table)).first;
+   return it->second;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+
+#include <nanodbc/nanodbc.h>
+
+#include "Platform.h"
+
+// type of a column as reported by SQLColumns
+struct ColumnType
+{
+   SQLSMALLINT sqlType {};
+   SQLULEN     columnSize {};
+   SQLSMALLINT decimalDigits {};
+};
+
+using TableColumns = std::unordered_map<std::string, ColumnType>;
+
+// columns of a table, read once with SQLColumns and cached for the process: every statement
+// of every connection importing into the table shares them.
+// empty when the driver does not tell, BulkInsert then refuses the table (see BulkInsert.h)
+const TableColumns& GetTableColumns(nanodbc::connection& conn, const std::string& table);
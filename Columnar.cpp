@@ -0,0 +1,160 @@
+#include "Columnar.h"
+
+#include <cstdint>
+#include <format>
+#include <stdexcept>
+
+namespace json = boost::json;
+
+namespace
+{
+   const json::string_view delta_rle = "delta-rle";
+
+   // wrap around like the unsigned type, so any delta of int64 round trips
+   std::int64_t Delta(std::int64_t value, std::int64_t previous)
+   {
+      return static_cast<std::int64_t>(static_cast<std::uint64_t>(value) - static_cast<std::uint64_t>(previous));
+   }
+}   // namespace
+
+json::value EncodeColumn(json::array column)
+{
+   for (const auto& value: column)
+      if (!value.is_int64())
+         return column;
+
+   json::array  runs;
+   std::int64_t previous {0};
+   std::int64_t delta {0};
+   std::int64_t count {0};
+   for (const auto& value: column)
+   {
+      auto valueDelta = Delta(value.get_int64(), previous);
+      previous        = value.get_int64();
+      if (count && valueDelta == delta)
+      {
+         count++;
+         continue;
+      }
+      if (count)
+      {
+         runs.push_back(delta);
+         runs.push_back(count);
+      }
+      delta = valueDelta;
+      count = 1;
+   }
+   if (count)
+   {
+      runs.push_back(delta);
+      runs.push_back(count);
+   }
+
+   // no gain, keep it readable
+   if (runs.size() >= column.size())
+      return column;
+
+   json::object encoded;
+   encoded["encoding"] = delta_rle;
+   encoded["runs"]     = std::move(runs);
+   return encoded;
+}
+
+json::array DecodeColumn(const json::value& column, size_t recordCount)
+{
+   if (column.is_array())
+      return column.get_array();
+
+   const auto& encoded  = column.as_object();
+   const auto& encoding = encoded.at("encoding").as_string();
+   if (encoding != delta_rle)
+      throw std::runtime_error(std::format("unknown column encoding: {}", std::string_view(encoding.data(), encoding.size())));
+
+   const auto& runs = encoded.at("runs").as_array();
+   if (runs.size() % 2)
+      throw std::runtime_error("delta-rle runs are delta and count pairs, odd number of values");
+
+   // counts are checked before anything is expanded
+   std::uint64_t total {0};
+   for (size_t idx = 1; idx < runs.size(); idx += 2)
+   {
+      auto count = runs[idx].as_int64();
+      if (count < 0)
+         throw std::runtime_error(std::format("delta-rle run with a negative count: {}", count));
+      total += static_cast<std::uint64_t>(count);
+      if (total > recordCount)
+         throw std::runtime_error(std::format("delta-rle runs hold more than {} value(s)", recordCount));
+   }
+
+   json::array   values;
+   std::uint64_t value {0};
+   values.reserve(static_cast<size_t>(total));
+   for (size_t idx = 0; idx < runs.size(); idx += 2)
+   {
+      auto delta = static_cast<std::uint64_t>(runs[idx].as_int64());
+      auto count = runs[idx + 1].as_int64();
+      for (std::int64_t i = 0; i < count; i++)
+      {
+         value += delta;
+         values.push_back(static_cast<std::int64_t>(value));
+      }
+   }
+   return values;
+}
+
+json::object RowsToColumns(const json::array& rows)
+{
+   json::object data;
+   for (size_t rowIdx = 0; rowIdx < rows.size(); rowIdx++)
+   {
+      for (const auto& column: rows[rowIdx].as_object())
+      {
+         auto& values = data[column.key()];
+         if (values.is_null())
+            values = json::array(rowIdx, nullptr);   // column first seen in this row
+         values.get_array().push_back(column.value());
+      }
+      // columns this row doesn't have
+      for (auto& column: data)
+         if (column.value().get_array().size() == rowIdx)
+            column.value().get_array().push_back(nullptr);
+   }
+
+   json::object table;
+   table["recordCount"] = rows.size();
+   table["data"]        = std::move(data);
+   return table;
+}
+
+ColumnarReader::ColumnarReader(const json::object& table)
+{
+   m_RecordCount    = table.at("recordCount").to_number<size_t>();
+   const auto& data = table.at("data").as_object();
+
+   // decoded columns are kept, the others are used in place
+   m_Decoded.reserve(data.size());
+   for (const auto& column: data)
+   {
+      m_Keys.emplace_back(column.key().data(), column.key().size());
+      if (column.value().is_array())
+      {
+         m_Columns.push_back(&column.value().get_array());
+      }
+      else
+      {
+         m_Decoded.push_back(DecodeColumn(column.value(), m_RecordCount));
+         m_Columns.push_back(&m_Decoded.back());
+      }
+      if (m_Columns.back()->size() != m_RecordCount)
+         throw std::runtime_error(std::format("column {} has {} value(s), expected {}", m_Keys.back(), m_Columns.back()->size(), m_RecordCount));
+   }
+}
+
+json::object ColumnarReader::Row(size_t rowIdx) const
+{
+   json::object row;
+   row.reserve(m_Keys.size());
+   for (size_t col = 0; col < m_Keys.size(); col++)
+      row[m_Keys[col]] = (*m_Columns[col])[rowIdx];
+   return row;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <boost/json.hpp>
+
+// structure of array layout of a table:
+// {
+//   "recordCount" : rows,
+//   "data" : { "column" : [ values... ] or encoded column, ... }
+// }
+// an encoded column is an object: { "encoding" : "delta-rle", "runs" : [ delta, count, ... ] }
+// starting from 0, each run adds delta to the previous value count times.
+// sorted integer keys (Msg_Code, Tag_Code, ...) become a handful of runs
+
+// delta-rle encode an integer column without NULL when it is smaller that way,
+// otherwise the column is returned as is
+boost::json::value EncodeColumn(boost::json::array column);
+
+// values of a column, encoded or not. malformed runs, or runs expanding to more than
+// recordCount values, throw before anything is expanded
+boost::json::array DecodeColumn(const boost::json::value& column, size_t recordCount);
+
+// structure of array layout of a table in the array of structure layout,
+// a column missing from some rows is NULL for those rows
+boost::json::object RowsToColumns(const boost::json::array& rows);
+
+// row access on a table in the structure of array layout, for the import
+class ColumnarReader
+{
+   std::vector<std::string>               m_Keys;
+   std::vector<boost::json::array>        m_Decoded;
+   std::vector<const boost::json::array*> m_Columns;
+   size_t                                 m_RecordCount {};
+
+public:
+   explicit ColumnarReader(const boost::json::object& table);
+
+   // m_Columns points into m_Decoded, a move keeps them valid, a copy would not
+   ColumnarReader(const ColumnarReader&) = delete;
+   ColumnarReader(ColumnarReader&&)      = default;
+
+   size_t size() const { return m_RecordCount; }
+
+   // row as it would be in the array of structure layout
+   boost::json::object Row(size_t rowIdx) const;
+};
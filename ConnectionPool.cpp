@@ -0,0 +1,22 @@
+#include "ConnectionPool.h"
+
+nanodbc::connection ConnectionPool::Acquire()
+{
+   {
+      std::lock_guard lock(m_Mutex);
+      if (!m_Idle.empty())
+      {
+         auto conn = std::move(m_Idle.back());
+         m_Idle.pop_back();
+         return conn;
+      }
+   }
+   // connecting is slow, don't hold the lock
+   return nanodbc::connection(m_ConnectionString);
+}
+
+void ConnectionPool::Release(nanodbc::connection conn)
+{
+   std::lock_guard lock(m_Mutex);
+   m_Idle.push_back(std::move(conn));
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <nanodbc/nanodbc.h>
+
+// connections to the same database, shared by worker threads.
+// a connection is only used by one thread at a time, new ones are opened on demand
+class ConnectionPool
+{
+   std::string                      m_ConnectionString;
+   std::mutex                       m_Mutex;
+   std::vector<nanodbc::connection> m_Idle;
+
+public:
+   explicit ConnectionPool(std::string connectionString) :
+      m_ConnectionString(std::move(connectionString)) {}
+
+   nanodbc::connection Acquire();
+   void                Release(nanodbc::connection conn);   // also used to seed the pool
+
+   // gives the connection back to the pool when going out of scope
+   class Lease
+   {
+      ConnectionPool&     m_Pool;
+      nanodbc::connection m_Conn;
+
+   public:
+      explicit Lease(ConnectionPool& pool) :
+         m_Pool(pool), m_Conn(pool.Acquire()) {}
+      ~Lease() { m_Pool.Release(std::move(m_Conn)); }
+
+      Lease(const Lease&)            = delete;
+      Lease& operator=(const Lease&) = delete;
+
+      nanodbc::connection& operator*() { return m_Conn; }
+      nanodbc::connection* operator->() { return &m_Conn; }
+   };
+};
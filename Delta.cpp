@@ -0,0 +1,87 @@
+#include "Delta.h"
+
+#include <algorithm>
+#include <format>
+#include <stdexcept>
+
+#include "PrettyPrint.h"
+
+namespace json = boost::json;
+
+namespace
+{
+   // hash of the row as written in a snapshot, doubles are rounded by pretty_print.
+   // a row read back from the previous snapshot must hash like the one from the database
+   std::uint64_t RowHash(const json::object& row)
+   {
+      static thread_local std::string text;
+      std::string                     indent;
+      text.clear();
+      JsonOutput(text).Pretty(row, indent);
+
+      // FNV-1a
+      std::uint64_t hash = 14695981039346656037ull;
+      for (auto c: text)
+      {
+         hash ^= static_cast<std::uint8_t>(c);
+         hash *= 1099511628211ull;
+      }
+      return hash;
+   }
+}   // namespace
+
+std::string DeltaTable::RowKey(const json::object& row) const
+{
+   json::array key;
+   for (const auto& column: m_KeyColumns)
+   {
+      auto value = row.if_contains(column);
+      key.push_back(value ? *value : json::value {});
+   }
+   return json::serialize(key);
+}
+
+void DeltaTable::AddPrevious(const json::object& row)
+{
+   auto key = RowKey(row);
+   if (!m_Previous.emplace(key, PreviousRow {RowHash(row), m_Previous.size()}).second)
+      throw std::runtime_error(std::format("duplicate key {} in previous snapshot", key));
+}
+
+void DeltaTable::AddCurrent(json::object row)
+{
+   auto key = RowKey(row);
+   if (!m_Current.insert(key).second)
+      throw std::runtime_error(std::format("duplicate key {} in current snapshot", key));
+   auto previous = m_Previous.find(key);
+   if (previous == m_Previous.end())
+   {
+      m_Inserted.push_back(std::move(row));
+      return;
+   }
+   if (previous->second.hash != RowHash(row))
+      m_Updated.push_back(std::move(row));
+   else
+      m_Unchanged++;
+   m_Previous.erase(previous);
+}
+
+json::array DeltaTable::Deleted() const
+{
+   std::vector<std::pair<size_t, const std::string*>> remaining;
+   remaining.reserve(m_Previous.size());
+   for (const auto& previous: m_Previous)
+      remaining.emplace_back(previous.second.index, &previous.first);
+   std::sort(remaining.begin(), remaining.end());
+
+   json::array deleted;
+   for (const auto& [index, key]: remaining)
+   {
+      auto         keyValues = json::parse(*key).as_array();
+      json::object keyRow;
+      for (size_t col = 0; col < m_KeyColumns.size(); col++)
+         keyRow[m_KeyColumns[col]] = std::move(keyValues[col]);
+      deleted.push_back(std::move(keyRow));
+   }
+   return deleted;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <boost/json.hpp>
+
+// row level difference of one table between a previous snapshot and the database.
+// rows are matched on their key columns (the table ORDER BY) and compared with a hash
+// of their json text, so only keys and hashes of the previous snapshot are kept.
+// changed rows are kept until the table is done, a delta is expected to be small
+class DeltaTable
+{
+   struct PreviousRow
+   {
+      std::uint64_t hash;
+      size_t        index;   // deleted rows are reported in the previous snapshot order
+   };
+
+   std::vector<std::string>                     m_KeyColumns;
+   std::unordered_map<std::string, PreviousRow> m_Previous;
+   std::unordered_set<std::string>              m_Current;   // keys seen, a matched previous row is erased
+   boost::json::array                           m_Inserted;
+   boost::json::array                           m_Updated;
+   size_t                                       m_Unchanged {};
+
+   std::string RowKey(const boost::json::object& row) const;
+
+public:
+   explicit DeltaTable(std::vector<std::string> keyColumns) :
+      m_KeyColumns(std::move(keyColumns)) {}
+
+   void AddPrevious(const boost::json::object& row);
+   void AddCurrent(boost::json::object row);
+
+   const boost::json::array& Inserted() const { return m_Inserted; }
+   const boost::json::array& Updated() const { return m_Updated; }
+   size_t                    Unchanged() const { return m_Unchanged; }
+
+   // key columns of the rows not found in the database
+   boost::json::array Deleted() const;
+};
@@ -0,0 +1,154 @@
+#include "ExportPipeline.h"
+
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "SpscQueue.h"
+
+namespace json = boost::json;
+
+namespace
+{
+   // rows copied by the fetch stage
+   struct RawBatch
+   {
+      std::vector<RowDecoder::RawValue> values;   // rows x columns
+      size_t                            rows {};
+   };
+
+   // rows built by the convert stage, allocated from the arena of the batch
+   struct JsonBatch
+   {
+      json::monotonic_resource  arena;
+      std::vector<json::object> rows;
+   };
+
+   // a null batch ends the rows
+   using RawQueue  = SpscQueue<std::unique_ptr<RawBatch>>;
+   using JsonQueue = SpscQueue<std::unique_ptr<JsonBatch>>;
+
+   // first exception of the stages. the stages keep draining their input once it is set,
+   // so none stays blocked on a full queue, but they don't do any work anymore
+   class PipelineError
+   {
+      std::mutex         m_Mutex;
+      std::exception_ptr m_Error;
+      std::atomic<bool>  m_Failed {};
+
+   public:
+      bool Failed() const { return m_Failed.load(std::memory_order_relaxed); }
+
+      void Set(std::exception_ptr error)
+      {
+         std::lock_guard lock(m_Mutex);
+         if (!m_Error)
+            m_Error = std::move(error);
+         m_Failed = true;
+      }
+
+      void Rethrow()
+      {
+         if (m_Error)
+            std::rethrow_exception(m_Error);
+      }
+   };
+
+   // a batch given back by the next stage, or a new one. batches are only created while
+   // none comes back, so there are never more than the queue and the two stages hold
+   template <typename Batch>
+   std::unique_ptr<Batch> Reuse(SpscQueue<std::unique_ptr<Batch>>& done)
+   {
+      auto batch = done.TryPop();
+      return batch ? std::move(*batch) : std::make_unique<Batch>();
+   }
+}   // namespace
+
+size_t PipelineRows(nanodbc::result& rowIt, const RowDecoder& decoder, const PipelineOptions& options,
+                    const std::function<void(const json::object& row)>& write, PipelineStalls& stalls)
+{
+   auto columns   = static_cast<size_t>(decoder.Columns());
+   auto batchRows = std::max<size_t>(1, options.batchRows);
+
+   // the queues of used batches never fill: they hold less than what is in flight
+   RawQueue      fetched(options.queueDepth);
+   RawQueue      fetchedDone(options.queueDepth + 2);
+   JsonQueue     converted(options.queueDepth);
+   JsonQueue     convertedDone(options.queueDepth + 2);
+   PipelineError error;
+
+   std::jthread fetch([&]()
+                      {
+                         try
+                         {
+                            for (bool more = true; more && !error.Failed();)
+                            {
+                               auto batch = Reuse(fetchedDone);
+                               batch->values.resize(batchRows * columns);
+                               batch->rows = 0;
+                               while (batch->rows < batchRows && (more = rowIt.next()))
+                                  decoder.CopyRow(rowIt, batch->values.data() + batch->rows++ * columns);
+                               if (batch->rows)
+                                  fetched.Push(std::move(batch), &stalls.fetchBlocked);
+                            }
+                         }
+                         catch (...)
+                         {
+                            error.Set(std::current_exception());
+                         }
+                         fetched.Push(nullptr, &stalls.fetchBlocked);
+                      });
+
+   std::jthread convert([&]()
+                        {
+                           while (auto batch = fetched.Pop(&stalls.convertStarved))
+                           {
+                              try
+                              {
+                                 if (!error.Failed())
+                                 {
+                                    auto out = Reuse(convertedDone);
+                                    out->rows.clear();
+                                    out->arena.release();
+                                    for (size_t row = 0; row < batch->rows; row++)
+                                       out->rows.push_back(decoder.ConvertRow(batch->values.data() + row * columns, json::storage_ptr(&out->arena)));
+                                    converted.Push(std::move(out), &stalls.convertBlocked);
+                                 }
+                              }
+                              catch (...)
+                              {
+                                 error.Set(std::current_exception());
+                              }
+                              fetchedDone.Push(std::move(batch));
+                           }
+                           converted.Push(nullptr, &stalls.convertBlocked);
+                        });
+
+   size_t rowCount {0};
+   while (auto batch = converted.Pop(&stalls.writeStarved))
+   {
+      try
+      {
+         if (!error.Failed())
+         {
+            for (const auto& row: batch->rows)
+               write(row);
+            rowCount += batch->rows.size();
+         }
+      }
+      catch (...)
+      {
+         error.Set(std::current_exception());
+      }
+      convertedDone.Push(std::move(batch));
+   }
+
+   fetch.join();
+   convert.join();
+   error.Rethrow();
+   return rowCount;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+
+#include <boost/json.hpp>
+#include <nanodbc/nanodbc.h>
+
+#include "RowDecoder.h"
+
+// the rows of an extraction query go through three stages, each on its own thread:
+// fetch copies the rows out of the result set (odbc), convert builds their json
+// (code page and utf-16 transcoding), write hands them to the output (serialization and i/o).
+// rows go from stage to stage in batches through bounded queues (SpscQueue.h),
+// batches come back empty to be reused, at most about 2 x queueDepth of them are in flight.
+// the export then takes the time of the slowest stage instead of the sum of the three
+struct PipelineOptions
+{
+   size_t batchRows {256};   // rows per batch
+   size_t queueDepth {4};    // batches waiting between two stages
+};
+
+// time the stages spent waiting for rows from the previous stage (starved)
+// or for room in the queue to the next one (blocked): the busiest stage waits the least
+struct PipelineStalls
+{
+   std::chrono::nanoseconds fetchBlocked {};
+   std::chrono::nanoseconds convertStarved {};
+   std::chrono::nanoseconds convertBlocked {};
+   std::chrono::nanoseconds writeStarved {};
+};
+
+// write runs on the calling thread with the rows in order, a row is only valid during the call.
+// the first exception of a stage stops the pipeline and is rethrown. returns the row count
+size_t PipelineRows(nanodbc::result& rowIt, const RowDecoder& decoder, const PipelineOptions& options,
+                    const std::function<void(const boost::json::object& row)>& write, PipelineStalls& stalls);
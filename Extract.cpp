@@ -0,0 +1,66 @@
+#include "Extract.h"
+
+#include "Platform.h"
+
+namespace
+{
+   bool IsLongData(SQLSMALLINT sqlType, SQLULEN columnSize)
+   {
+      switch (sqlType)
+      {
+         case SQL_LONGVARBINARY:
+         case SQL_LONGVARCHAR:
+         case SQL_WLONGVARCHAR:
+            return true;
+      }
+      // unknown size, can't be bound
+      return columnSize == 0;
+   }
+
+   // the statement is only prepared, the driver can describe the result set
+   // without running the query
+   bool HasLongDataColumn(nanodbc::statement& stmt)
+   {
+      auto        hstmt = stmt.native_statement_handle();
+      SQLSMALLINT colCount {};
+      if (!SQL_SUCCEEDED(SQLNumResultCols(hstmt, &colCount)))
+         return true;   // can't tell, play safe
+
+      for (SQLUSMALLINT col = 1; col <= static_cast<SQLUSMALLINT>(colCount); col++)
+      {
+         SQLSMALLINT sqlType {};
+         SQLULEN     columnSize {};
+         SQLSMALLINT decimalDigits {};
+         SQLSMALLINT nullable {};
+         if (!SQL_SUCCEEDED(SQLDescribeCol(hstmt, col, nullptr, 0, nullptr, &sqlType, &columnSize, &decimalDigits, &nullable)))
+            return true;
+         if (IsLongData(sqlType, columnSize))
+            return true;
+      }
+      return false;
+   }
+
+   bool AllColumnsBound(nanodbc::result& result)
+   {
+      for (short col = 0; col < result.columns(); col++)
+         if (!result.is_bound(col))
+            return false;
+      return true;
+   }
+}   // namespace
+
+nanodbc::result ExecuteExtract(nanodbc::connection& conn, const std::string& qry, long rowsetSize)
+{
+   nanodbc::statement stmt(conn, qry);
+   if (rowsetSize > 1 && HasLongDataColumn(stmt))
+      rowsetSize = 1;
+
+   auto result = stmt.execute(rowsetSize);
+
+   // nanodbc can still decide a column is too large to be bound,
+   // SQLGetData would then fail on a multi row rowset: execute again row by row
+   if (rowsetSize > 1 && !AllColumnsBound(result))
+      result = stmt.execute(1);
+
+   return result;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <string>
+
+#include <nanodbc/nanodbc.h>
+
+// rows returned by each SQLFetchScroll when nothing is specified
+constexpr long default_rowset_size = 1024;
+
+// execute an extraction query with a block cursor of rowsetSize rows.
+// nanodbc binds the columns column-wise, next() then walks the rowset in memory
+// and only goes back to the driver once it is consumed.
+// long data columns (memo, blob) are fetched with SQLGetData which the driver only
+// allows one row at a time, for those queries the rowset falls back to a single row
+nanodbc::result ExecuteExtract(nanodbc::connection& conn, const std::string& qry, long rowsetSize);
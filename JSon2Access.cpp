@@ -24,30 +24,34 @@ FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
 ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
 DEALINGS IN THE SOFTWARE.
 */
-#include "utf8Conversion.h"
+#include "Base64.h"
+#include "BulkInsert.h"
+#include "Checkpoint.h"
+#include "CmdLine.h"
+#include "CodePage.h"
+#include "ConnectionPool.h"
+#include "Delta.h"
+#include "MappedFile.h"
+#include "RowDecoder.h"
+#include "Snapshot.h"
+#include "TableGraph.h"
 
 #include <boost/json.hpp>
 #include <nanodbc/nanodbc.h>
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <cstdint>
 #include <format>
-#include <fstream>
+#include <functional>
 #include <iostream>
+#include <optional>
 #include <set>
 #include <variant>
 
 namespace json = boost::json;
 
-// this is the locale used by the console in Québec!!!
-static std::locale loc850(".850");
-
-std::string readJsonFile(const std::string& filename)
-{
-   std::ifstream input(filename);
-   return std::string((std::istreambuf_iterator<char>(input)),
-                      std::istreambuf_iterator<char>());
-}
-
 /*
 specify tables to erase  order is important
 specify data to import, order is important and not necessarely same as in erase
@@ -74,134 +78,513 @@ std::vector<std::string> g_tables = {
    {"LoggerMessages"},
 };
 
-std::vector<int> deletionOrder = {
-   LOGGERMESSAGES,
-   MESSAGE,
-   LOGFILES,
-   FIELDS,
-   TAGS,
+// used when the foreign keys can't be read from the catalog (the access driver),
+// {table, referenced table}: Tags, LogFiles and Messages are unrelated and run concurrently
+std::vector<std::pair<size_t, size_t>> g_foreignKeys = {
+   {FIELDS, TAGS},
+   {FIELDS, MESSAGE},
+   {LOGGERMESSAGES, LOGFILES},
+   {LOGGERMESSAGES, MESSAGE},
 };
 
-std::vector<int> creationOrder = {
-   TAGS,
-   FIELDS,
-   LOGFILES,
-   MESSAGE,
-   LOGGERMESSAGES,
+// rows are matched on them by a differential import, the ORDER BY of TlgAccess2Json
+std::vector<std::vector<std::string>> g_keyColumns = {
+   {"Tag_Code"},
+   {"Msg_Code", "Tag_Code"},
+   {"Log_Code"},
+   {"Msg_Code"},
+   {"Schema", "Log_Code", "Msg_Code"},
 };
 
-std::string Quotify(std::string s)
+struct ImportOptions
 {
-   std::string r;
-   for (int i = 0; i < s.size(); i++)
-      if (s[i] == '\'')
-         r += "''";
-      else
-         r += s[i];
-   return r;
+   const CodePage* codePage {&CodePage::Cp1252()};   // of the database narrow strings
+   size_t          batchSize {default_insert_batch};   // rows per SQLExecute
+   size_t          jobs {4};                           // tables imported concurrently
+   bool            diff {};                            // only the changes instead of deleting everything
+   size_t          commitRows {};                      // rows per transaction, 0: one per table
+   size_t          commitBytes {};                     // or bytes of values per transaction
+   Checkpoint*     checkpoint {};                      // a failed import can be resumed
+};
+
+// rows of all the tables, reported once the import is done
+struct ImportCounts
+{
+   std::atomic<size_t> inserted {};
+   std::atomic<size_t> updated {};
+   std::atomic<size_t> deleted {};
+   std::atomic<size_t> unchanged {};
+};
+
+// size of the values of a row, for --commit-bytes
+size_t RowBytes(const json::object& row)
+{
+   size_t bytes {0};
+   for (const auto& member: row)
+      bytes += member.value().is_string() ? member.value().get_string().size() : sizeof(double);
+   return bytes;
 }
 
-std::string ToDb(const json::value& jv)
+// blobs of older snapshots are arrays of byte values, a differential import compares them
+// as the base64 strings the database rows are read back with
+json::object Base64Blobs(json::object row)
 {
-   switch (jv.kind())
+   std::string bytes;
+   for (auto& member: row)
    {
-      case json::kind::uint64:
-         return std::to_string(jv.get_uint64());
+      if (!member.value().is_array())
+         continue;
+      bytes.clear();
+      for (const auto& byte: member.value().get_array())
+         bytes.push_back(static_cast<char>(byte.to_number<std::uint8_t>()));
+      json::string text;
+      text.resize(Base64EncodedSize(bytes.size()));
+      Base64Encode(bytes.data(), bytes.size(), text.data());
+      member.value() = std::move(text);
+   }
+   return row;
+}
+
+// returns the number of rows rejected by the driver, each of them is reported
+size_t ReportRejected(const BulkInsert& bulk, const std::string& tableName)
+{
+   for (const auto& error: bulk.Errors())
+      std::cerr << ToConsole(std::format("row {} of {} rejected: {}\n   {}", error.row, tableName, error.message, error.text)) << std::endl;
+   return bulk.Errors().size();
+}
 
-      case json::kind::int64:
-         return std::to_string(jv.get_int64());
+// one table imported in its own transaction, or in one per commit interval: jet slows down
+// badly on huge transactions. nothing is committed when a row of the transaction is rejected,
+// all of them are reported first. commits are recorded by the checkpoint, a resumed import
+// skips the rows already committed.
+// a differential import reads the rows of the table first and matches the snapshot ones on their
+// key columns (see Delta.h, the database is the previous side): only new rows are inserted and
+// changed ones updated. rows missing from the snapshot are returned by Commit, they can only be
+// deleted once the tables referencing them are done. it needs no checkpoint, a new run only
+// sends what still differs
+class TableImport
+{
+   std::string                         m_TableName;
+   size_t                              m_Table;
+   nanodbc::connection&                m_Conn;
+   const ImportOptions&                m_Options;
+   std::optional<nanodbc::transaction> m_Transaction;
+   BulkInsert                          m_Inserter;
+   std::optional<BulkInsert>           m_Updater;
+   std::optional<DeltaTable>           m_Delta;
+   size_t                              m_RowsDone {0};   // rows of the snapshot, the skipped ones included
+   size_t                              m_Skip {0};       // committed by a previous run
+   size_t                              m_PendingRows {0};
+   size_t                              m_PendingBytes {0};
+
+   // a row was sent, the transaction is committed once the interval is reached
+   void Pending(const json::object& row)
+   {
+      m_PendingRows++;
+      m_PendingBytes += RowBytes(row);
+      if ((m_Options.commitRows && m_PendingRows >= m_Options.commitRows) || (m_Options.commitBytes && m_PendingBytes >= m_Options.commitBytes))
+         CommitPending(false);
+   }
 
-      case json::kind::null:
-         return "NULL";
+   void CommitPending(bool done)
+   {
+      m_Inserter.Flush();
+      if (m_Updater)
+         m_Updater->Flush();
+      auto rejected = ReportRejected(m_Inserter, m_TableName) + (m_Updater ? ReportRejected(*m_Updater, m_TableName) : 0);
+      if (rejected)
+         throw std::runtime_error(std::format("{} row(s) rejected by table {}", rejected, m_TableName));
+
+      m_Transaction->commit();
+      if (m_Options.checkpoint && !m_Delta)
+         m_Options.checkpoint->Commit(m_TableName, m_RowsDone, done);
+      m_PendingRows  = 0;
+      m_PendingBytes = 0;
+      if (!done)
+         m_Transaction.emplace(m_Conn);
+   }
 
-      case json::kind::string:
-         return "'" + Quotify(Utf8ToCp1252(jv.get_string().c_str())) + "'";
+public:
+   TableImport(nanodbc::connection& conn, size_t table, const ImportOptions& options) :
+      m_TableName(g_tables.at(table)),
+      m_Table(table),
+      m_Conn(conn),
+      m_Options(options),
+      m_Transaction(std::in_place, conn),
+      m_Inserter(conn, m_TableName, *options.codePage, options.batchSize)
+   {
+      if (!options.diff)
+      {
+         m_Skip = options.checkpoint ? options.checkpoint->Rows(m_TableName) : 0;
+         if (m_Skip)
+            std::cout << std::format("{}: resuming after {} committed row(s)", m_TableName, m_Skip) << std::endl;
+         return;
+      }
 
-      case json::kind::double_:
-         return std::to_string(jv.get_double());
+      m_Updater.emplace(conn, m_TableName, BulkInsert::Statement::Update, g_keyColumns.at(table), *options.codePage, options.batchSize);
+      m_Delta.emplace(g_keyColumns.at(table));
+      auto       rowIt = nanodbc::execute(conn, std::format("SELECT * FROM {}", m_TableName));
+      RowDecoder decoder(rowIt, *options.codePage, BlobFormat::Base64);
+      while (rowIt.next())
+         m_Delta->AddPrevious(decoder.DecodeRow(rowIt));
    }
-   throw std::runtime_error("invalid json kind for database");
-}
 
+   void Add(const json::object& row)
+   {
+      if (++m_RowsDone <= m_Skip || row.empty())
+         return;
+      if (m_Delta)
+      {
+         m_Delta->AddCurrent(Base64Blobs(json::object(row)));
+      }
+      else
+      {
+         m_Inserter.Add(row);
+         Pending(row);
+      }
+      if (!(m_RowsDone % 250))
+      {
+         std::cout << std::format("{}: insertion row done: {}\r", m_TableName, m_RowsDone) << std::flush;
+      }
+   }
 
-int main(int argc, char** argv)
+   // returns the key columns of the rows to delete
+   json::array Commit(ImportCounts& counts)
+   {
+      if (m_Delta)
+      {
+         for (const auto& row: m_Delta->Inserted())
+         {
+            m_Inserter.Add(row.get_object());
+            Pending(row.get_object());
+         }
+         for (const auto& row: m_Delta->Updated())
+         {
+            m_Updater->Add(row.get_object());
+            Pending(row.get_object());
+         }
+      }
+      std::cout << std::format("{}: insertion row done: {}", m_TableName, m_RowsDone) << std::endl;
+      CommitPending(true);
+
+      json::array deleted;
+      counts.inserted += m_Inserter.Applied();
+      if (m_Delta)
+      {
+         deleted = m_Delta->Deleted();
+         counts.updated += m_Updater->Applied();
+         counts.unchanged += m_Delta->Unchanged();
+         std::cout << std::format("{}: committed {} inserted, {} updated, {} unchanged row(s), {} to delete", m_TableName, m_Inserter.Applied(), m_Updater->Applied(), m_Delta->Unchanged(), deleted.size()) << std::endl;
+      }
+      else
+      {
+         std::cout << std::format("{}: committed {} row(s)", m_TableName, m_Inserter.Applied()) << std::endl;
+      }
+      return deleted;
+   }
+};
+
+// tables are discovered from the foreign keys when the driver can tell, from g_foreignKeys otherwise
+TableGraph GetTableGraph(ConnectionPool& pool)
 {
+   ConnectionPool::Lease conn(pool);
    try
    {
-      std::string database {argv[1]};
-      auto        connection_string =
-         "Driver={Microsoft Access Driver (*.mdb, *.accdb)};Dbq=" + database;
-      std::string jsonData = readJsonFile(argv[2]);
+      if (auto graph = TableGraph::FromCatalog(*conn, g_tables))
+         return std::move(*graph);
+   }
+   catch (const nanodbc::database_error&)
+   {
+   }
+   std::cout << "foreign keys not available from the driver, using the known ones" << std::endl;
+   return TableGraph::FromForeignKeys(g_tables, g_foreignKeys);
+}
+
+// tables referencing a table are emptied before it, unrelated tables concurrently.
+// each DELETE is committed on its own connection
+void DeleteTables(ConnectionPool& pool, const TableGraph& graph, const ImportOptions& options, ImportCounts& counts)
+{
+   graph.Run(options.jobs, true, [&](size_t table)
+             {
+                ConnectionPool::Lease conn(pool);
+                auto                  rowIt = nanodbc::execute(*conn, std::format("DELETE FROM {}", graph.Name(table)));
+                if (rowIt.has_affected_rows())
+                {
+                   counts.deleted += rowIt.affected_rows();
+                   std::cout << std::format("{}: deleted row(s): {}", graph.Name(table), rowIt.affected_rows()) << std::endl;
+                }
+             });
+}
+
+// the tables are emptied before the rows are imported: a streamed snapshot is parsed once first,
+// a malformed or truncated one, or one missing a table, leaves the database untouched
+void CheckSnapshot(const TableGraph& graph, const std::optional<Snapshot>& snapshot, const MappedFile& file, const ImportOptions& options)
+{
+   std::vector<std::string> tables;
+   if (!snapshot)
+      tables = SnapshotTables(file.View(), options.jobs);
+   for (size_t table = 0; table < graph.size(); table++)
+   {
+      const auto& tableName = graph.Name(table);
+      if (snapshot ? !snapshot->HasTable(tableName) : std::ranges::find(tables, tableName) == tables.end())
+         throw std::runtime_error(std::format("table {} not in snapshot, nothing deleted", tableName));
+   }
+}
 
-      auto jsonDoc = json::parse(jsonData);
+// rows of a differential import missing from the snapshot, by key columns.
+// as for DeleteTables, the rows of the tables referencing a table are deleted first
+void DeleteRows(ConnectionPool& pool, const TableGraph& graph, const std::vector<json::array>& deleted, const ImportOptions& options, ImportCounts& counts)
+{
+   graph.Run(options.jobs, true, [&](size_t table)
+             {
+                const auto& tableName = graph.Name(table);
+                if (deleted[table].empty())
+                   return;
+
+                ConnectionPool::Lease conn(pool);
+                nanodbc::transaction  transaction(*conn);
+                BulkInsert            deleter(*conn, tableName, BulkInsert::Statement::Delete, g_keyColumns.at(table), *options.codePage, options.batchSize);
+                for (const auto& key: deleted[table])
+                   deleter.Add(key.get_object());
+                deleter.Flush();
+                if (auto rejected = ReportRejected(deleter, tableName))
+                   throw std::runtime_error(std::format("{} row(s) of table {} can't be deleted", rejected, tableName));
+
+                counts.deleted += deleter.Applied();
+                std::cout << std::format("{}: deleted row(s): {}", tableName, deleter.Applied()) << std::endl;
+                transaction.commit();
+             });
+}
 
-      nanodbc::connection conn(connection_string);
+// whole snapshot in memory, a table is imported once the tables it references are committed,
+// unrelated tables concurrently, each in its own transaction on its own connection.
+// returns the rows to delete of each table, see TableImport
+std::vector<json::array> ImportSnapshot(ConnectionPool& pool, const TableGraph& graph, const Snapshot& snapshot, const ImportOptions& options, ImportCounts& counts)
+{
+   std::vector<json::array> deleted(graph.size());
+   graph.Run(options.jobs, false, [&](size_t table)
+             {
+                const auto& tableName = graph.Name(table);
+                if (options.checkpoint && options.checkpoint->Done(tableName))
+                {
+                   std::cout << std::format("{}: already imported", tableName) << std::endl;
+                   return;
+                }
+                auto tableData = snapshot.Table(tableName);
+                std::cout << std::format("about to insert: {} rows into table {}", tableData.size(), tableName) << std::endl;
+
+                ConnectionPool::Lease conn(pool);
+                TableImport           tableImport(*conn, table, options);
+                tableData.ForEach([&](const json::object& row)
+                                  { tableImport.Add(row); });
+                deleted[table] = tableImport.Commit(counts);
+             });
+   return deleted;
+}
 
-      for (auto tblId: deletionOrder)
+// changes of a TlgDelta snapshot, taken against what the database holds: a table's rows are inserted
+// and updated once the tables it references are committed, unrelated tables concurrently, each in its
+// own transaction on its own connection. nothing of a table is committed when a row is rejected,
+// ex: a row inserted twice. returns the key columns of the rows to delete, as ImportSnapshot does
+std::vector<json::array> ApplyDelta(ConnectionPool& pool, const TableGraph& graph, const DeltaSnapshot& delta, const ImportOptions& options, ImportCounts& counts)
+{
+   std::vector<json::array> deleted(graph.size());
+   graph.Run(options.jobs, false, [&](size_t table)
+             {
+                const auto& tableName = graph.Name(table);
+                if (!delta.HasTable(tableName))
+                {
+                   std::cout << std::format("{}: not in delta, unchanged", tableName) << std::endl;
+                   return;
+                }
+
+                ConnectionPool::Lease conn(pool);
+                nanodbc::transaction  transaction(*conn);
+                BulkInsert            inserter(*conn, tableName, *options.codePage, options.batchSize);
+                BulkInsert            updater(*conn, tableName, BulkInsert::Statement::Update, g_keyColumns.at(table), *options.codePage, options.batchSize);
+                for (const auto& row: delta.Inserted(tableName))
+                   inserter.Add(row.get_object());
+                for (const auto& row: delta.Updated(tableName))
+                   updater.Add(row.get_object());
+                inserter.Flush();
+                updater.Flush();
+                if (auto rejected = ReportRejected(inserter, tableName) + ReportRejected(updater, tableName))
+                   throw std::runtime_error(std::format("{} row(s) rejected by table {}", rejected, tableName));
+                transaction.commit();
+
+                counts.inserted += inserter.Applied();
+                counts.updated += updater.Applied();
+                deleted[table] = delta.Deleted(tableName);
+                std::cout << std::format("{}: committed {} inserted, {} updated row(s), {} to delete", tableName, inserter.Applied(), updater.Applied(), deleted[table].size()) << std::endl;
+             });
+   return deleted;
+}
+
+// rows are imported as they are parsed, tables in the order of the file.
+// TlgAccess2Json writes a table after the ones it references, a table coming before one it references is refused.
+// parse runs StreamSnapshot on the mapped text or on stdin
+std::vector<json::array> StreamImport(nanodbc::connection& conn, const TableGraph& graph, const std::function<void(const SnapshotVisitor&)>& parse, const ImportOptions& options, ImportCounts& counts)
+{
+   std::optional<TableImport> table;
+   std::vector<bool>          imported(graph.size());
+   std::vector<json::array>   deleted(graph.size());
+
+   SnapshotVisitor visitor;
+   visitor.beginTable = [&](const std::string& tableName)
+   {
+      auto tableIdx = graph.Find(tableName);
+      if (!tableIdx)
       {
-         std::string eraseCmd = std::format("DELETE FROM {}", g_tables.at(tblId));
-         auto        rowIt    = nanodbc::execute(conn, eraseCmd);
-         if (rowIt.has_affected_rows())
-         {
-            std::cout << std::format("deleted row(s): {}", rowIt.affected_rows()) << std::endl;
-         }
+         std::cout << std::format("table {} is not imported", tableName) << std::endl;
+         return;
+      }
+      for (auto parent: graph.Parents(*tableIdx))
+         if (!imported[parent])
+            throw std::runtime_error(std::format("table {} comes before {}, use --no-stream", tableName, graph.Name(parent)));
+      imported[*tableIdx] = true;
+      if (options.checkpoint && options.checkpoint->Done(tableName))
+      {
+         std::cout << std::format("{}: already imported", tableName) << std::endl;
+         return;
       }
 
-      auto        version    = jsonDoc.at("version");
-      auto        schema     = jsonDoc.at("TlgSchema");
-      auto const& jsonTables = schema.get_object();
+      std::cout << std::format("about to insert rows into table {}", tableName) << std::endl;
+      table.emplace(conn, *tableIdx, options);
+   };
+   visitor.row = [&](const json::object& row)
+   {
+      if (table)
+         table->Add(row);
+   };
+   visitor.endTable = [&](const std::string& tableName)
+   {
+      if (table)
+         deleted[*graph.Find(tableName)] = table->Commit(counts);
+      table.reset();
+   };
 
-      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+   parse(visitor);
 
-      for (auto tblId: creationOrder)
+   if (auto missing = std::ranges::find(imported, false); missing != imported.end())
+      throw std::runtime_error(std::format("table {} not in snapshot", graph.Name(static_cast<size_t>(missing - imported.begin()))));
+   return deleted;
+}
+
+int main(int argc, char** argv)
+{
+   try
+   {
+      CmdLine cmdLine(argc, argv);
+      if (cmdLine.Positional().size() != 2)
       {
-         auto   tableName = g_tables.at(tblId);
-         auto   tableData = jsonTables.at(tableName).as_array();
-         size_t rowsDone {0};
-         std::cout << std::format("about to insert: {} rows into table {}", tableData.size(), tableName) << std::endl;
+         std::cerr << "usage: JSon2Access database snapshot|- [--codepage=name] [--batch=rows] [--jobs=n] [--diff] [--delta] [--no-stream]" << std::endl;
+         std::cerr << "                   [--commit-rows=n] [--commit-bytes=n] [--checkpoint=file]" << std::endl;
+         std::cerr << "       a json or ndjson snapshot is streamed unless --no-stream, a binary one is used in place" << std::endl;
+         std::cerr << "       json rows and ndjson lines are parsed by up to --jobs threads" << std::endl;
+         std::cerr << "       up to --jobs tables without foreign keys between them are deleted and inserted concurrently" << std::endl;
+         std::cerr << "       --diff only inserts, updates and deletes the rows which differ from the database" << std::endl;
+         std::cerr << "       --delta applies a TlgDelta snapshot of TlgAccess2Json --delta to the database it was taken from" << std::endl;
+         std::cerr << "       a snapshot is checked before the tables are emptied, stdin needs --no-stream unless --diff" << std::endl;
+         std::cerr << "       a table is committed every --commit-rows rows or --commit-bytes bytes of values, at once by default" << std::endl;
+         std::cerr << "       with --checkpoint a failed import run again resumes after the last commit" << std::endl;
+         return 1;
+      }
 
-         nanodbc::transaction transaction(conn);
-         for (const auto& data: tableData)
-         {
-            const auto& row = data.as_object();
-            if (row.empty())
-               continue;
-            std::string colList;
-            std::string values;
+      std::string database {cmdLine.Positional()[0]};
+      auto        connection_string =
+         "Driver={Microsoft Access Driver (*.mdb, *.accdb)};Dbq=" + database;
+      ImportOptions options;
+      options.codePage    = &CodePage::Get(cmdLine.Get("codepage", "1252"));
+      options.batchSize   = cmdLine.GetSize("batch", default_insert_batch);
+      options.jobs        = std::max<size_t>(1, cmdLine.GetSize("jobs", 4));
+      options.diff        = cmdLine.Has("diff");
+      options.commitRows  = cmdLine.GetSize("commit-rows", 0);
+      options.commitBytes = cmdLine.GetSize("commit-bytes", 0);
+
+      // a delta holds its own inserts, updates and deletes, it is parsed whole before any of them
+      bool applyDelta = cmdLine.Has("delta");
+      if (applyDelta && (options.diff || cmdLine.Has("checkpoint") || options.commitRows || options.commitBytes))
+         throw std::runtime_error("--delta commits each table at once, without --diff, --checkpoint or --commit-rows/--commit-bytes");
+
+      // stdin is streamed as it arrives, a file is mapped and parsed in place
+      std::string input {cmdLine.Positional()[1]};
+      bool        fromStdin = input == "-" && !cmdLine.Has("no-stream") && !applyDelta;
+      MappedFile  file;
+      if (fromStdin && !options.diff)
+         throw std::runtime_error("the tables are emptied before the import, a snapshot on stdin can't be checked first: use --no-stream or --diff");
+      if (!fromStdin)
+         file = MappedFile(input);
+
+      std::optional<Checkpoint> checkpoint;
+      if (cmdLine.Has("checkpoint"))
+      {
+         if (options.diff)
+            throw std::runtime_error("--checkpoint is not needed with --diff, a new run only sends the remaining differences");
+         if (input == "-")
+            throw std::runtime_error("--checkpoint needs a snapshot file, stdin can't be recognized by the next run");
+         checkpoint.emplace(cmdLine.Get("checkpoint"), input, file.View());
+         options.checkpoint = &*checkpoint;
+         if (checkpoint->Resumed())
+            std::cout << std::format("resuming the import from checkpoint {}", cmdLine.Get("checkpoint")) << std::endl;
+      }
 
-            for (auto it = row.begin(); it != row.end(); ++it)
-            {
-               if (it != row.begin())
-               {
-                  colList += ", ";
-                  values += ", ";
-               }
-
-               colList += it->key_c_str();
-               values += ToDb(it->value());
-            }
-            auto sqlCmd = std::format("insert into {} ({}) VALUES({});", tableName, colList, values);
-            nanodbc::execute(conn, sqlCmd);
-            rowsDone++;
-            if (!(rowsDone % 250))
-            {
-               std::cout << std::format("Insertion row done: {}\r", rowsDone) << std::flush;
-            }
-         }
-         std::cout << std::format("Insertion row done: {}\r", rowsDone) << std::endl;
-         std::cout << std::format("About to commit {} row(s)", rowsDone) << std::endl;
+      std::optional<Snapshot>      snapshot;
+      std::optional<DeltaSnapshot> delta;
+      if (applyDelta)
+         delta.emplace(std::move(file));
+      else if (!fromStdin && (cmdLine.Has("no-stream") || IsBinarySnapshot(file.View())))
+         snapshot.emplace(std::move(file), options.jobs);
+
+      ConnectionPool pool(connection_string);
+      auto           graph = GetTableGraph(pool);
+      ImportCounts   counts;
+      if (!options.diff && !delta && !(checkpoint && checkpoint->Deleted()))
+      {
+         CheckSnapshot(graph, snapshot, file, options);
+         DeleteTables(pool, graph, options, counts);
+         if (checkpoint)
+            checkpoint->SetDeleted();
+      }
 
-         transaction.commit();
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+      std::vector<json::array> deleted;
+      if (delta)
+      {
+         deleted = ApplyDelta(pool, graph, *delta, options, counts);
       }
+      else if (snapshot)
+      {
+         deleted = ImportSnapshot(pool, graph, *snapshot, options, counts);
+      }
+      else
+      {
+         // the file is parsed once, in order: one table at a time
+         ConnectionPool::Lease conn(pool);
+         deleted = StreamImport(
+            *conn, graph, [&](const SnapshotVisitor& visitor)
+            {
+               if (fromStdin)
+                  StreamSnapshot(std::cin, visitor, options.jobs);
+               else
+                  StreamSnapshot(file.View(), visitor, options.jobs);
+            },
+            options, counts);
+      }
+      if (options.diff || delta)
+         DeleteRows(pool, graph, deleted, options, counts);
+      if (checkpoint)
+         checkpoint->Remove();
 
       std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
 
+      std::cout << std::format("{} row(s) inserted, {} updated, {} deleted, {} unchanged", counts.inserted.load(), counts.updated.load(), counts.deleted.load(), counts.unchanged.load()) << std::endl;
       std::cout << std::format("Time difference = {} ms ", std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count()) << std::endl;
    }
    catch (const std::exception& e)
    {
-      std::cerr << e.what() << '\n';
+      std::cerr << ToConsole(e.what()) << '\n';
    }
 
    return 0;
-}
\ No newline at end of file
+}
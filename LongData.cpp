@@ -0,0 +1,216 @@
+#include "LongData.h"
+
+#include <algorithm>
+#include <format>
+#include <stdexcept>
+#include <string_view>
+
+#include "Base64.h"
+#include "utf8Conversion.h"
+
+namespace json = boost::json;
+
+namespace
+{
+   // bytes per SQLGetData call: a multiple of 3, chunks of a blob are encoded without carry,
+   // and of 2, for the utf-16 text
+   constexpr size_t long_data_chunk = 3 * 16 * 1024;
+
+   bool IsHighSurrogate(char16_t unit) { return unit >= 0xd800 && unit < 0xdc00; }
+}   // namespace
+
+LongDataWriter::LongDataWriter(nanodbc::result& result, const RowDecoder& decoder, const CodePage& codePage) :
+   m_Decoder(decoder),
+   m_CodePage(codePage),
+   m_Chunk(long_data_chunk)
+{
+   for (short col = 0; col < result.columns(); col++)
+   {
+      auto kind = Kind::Decoded;
+      // bound columns are in the rowset buffers already
+      if (!result.is_bound(col))
+      {
+         switch (result.column_datatype(col))
+         {
+            case SQL_LONGVARBINARY:
+               kind = Kind::Binary;
+               break;
+            case SQL_LONGVARCHAR:
+               kind = Kind::Narrow;
+               break;
+            case SQL_WLONGVARCHAR:
+               kind = Kind::Wide;
+               break;
+         }
+      }
+      m_Kinds.push_back(kind);
+   }
+}
+
+bool LongDataWriter::HasLongData() const
+{
+   return std::ranges::any_of(m_Kinds, [](Kind kind) { return kind != Kind::Decoded; });
+}
+
+// fn(data, size) for each chunk of the column, false when it is NULL.
+// terminator is the size of the null character odbc puts after a truncated text chunk
+template <typename Fn>
+bool LongDataWriter::ReadChunks(nanodbc::result& row, short col, SQLSMALLINT cType, size_t terminator, Fn&& fn)
+{
+   auto hstmt = row.native_statement_handle();
+   for (;;)
+   {
+      SQLLEN indicator {};
+      auto   rc = SQLGetData(hstmt, static_cast<SQLUSMALLINT>(col + 1), cType, m_Chunk.data(), static_cast<SQLLEN>(m_Chunk.size()), &indicator);
+      if (rc == SQL_NO_DATA)
+         return true;
+      if (!SQL_SUCCEEDED(rc))
+         throw std::runtime_error(std::format("reading long data column {} failed", m_Decoder.Key(col)));
+      if (indicator == SQL_NULL_DATA)
+         return false;
+
+      // truncated: the chunk is full, what remains is returned by the next calls
+      auto full = m_Chunk.size() - terminator;
+      bool more = rc == SQL_SUCCESS_WITH_INFO && (indicator == SQL_NO_TOTAL || static_cast<size_t>(indicator) > full);
+      fn(m_Chunk.data(), more ? full : static_cast<size_t>(indicator));
+      if (!more)
+         return true;
+   }
+}
+
+void LongDataWriter::WriteLong(nanodbc::result& row, short col, JsonOutput& out)
+{
+   bool opened {};
+   auto open = [&]()
+   {
+      if (!opened)
+         out.BeginString();
+      opened = true;
+   };
+
+   bool notNull {};
+   switch (m_Kinds[col])
+   {
+      case Kind::Binary:
+         notNull = ReadChunks(row, col, SQL_C_BINARY, 0, [&](const char* data, size_t size)
+                              {
+                                 open();
+                                 m_Text.resize(Base64EncodedSize(size));
+                                 Base64Encode(data, size, m_Text.data());
+                                 out.Raw(m_Text);   // nothing to escape
+                              });
+         break;
+
+      case Kind::Narrow:
+         notNull = ReadChunks(row, col, SQL_C_CHAR, 1, [&](const char* data, size_t size)
+                              {
+                                 open();
+                                 m_Text.resize(CodePage::MaxToUtf8Size(size));
+                                 m_Text.resize(m_CodePage.ToUtf8(std::string_view(data, size), m_Text.data()).written);
+                                 out.StringPart(m_Text);
+                              });
+         break;
+
+      case Kind::Wide:
+         m_Wide.clear();
+         notNull = ReadChunks(row, col, SQL_C_WCHAR, sizeof(char16_t), [&](const char* data, size_t size)
+                              {
+                                 open();
+                                 auto units = reinterpret_cast<const char16_t*>(data);
+                                 m_Wide.append(units, units + size / sizeof(char16_t));
+                                 // a surrogate pair can be cut between two chunks
+                                 char16_t carry {};
+                                 if (!m_Wide.empty() && IsHighSurrogate(m_Wide.back()))
+                                 {
+                                    carry = m_Wide.back();
+                                    m_Wide.pop_back();
+                                 }
+                                 m_Text.resize(MaxUtf16ToUtf8Size(m_Wide.size()));
+                                 m_Text.resize(Utf16ToUtf8(m_Wide, m_Text.data()).written);
+                                 out.StringPart(m_Text);
+                                 m_Wide.clear();
+                                 if (carry)
+                                    m_Wide.push_back(carry);
+                              });
+         if (!m_Wide.empty())
+         {
+            // unpaired at the end of the text
+            m_Text.resize(MaxUtf16ToUtf8Size(m_Wide.size()));
+            m_Text.resize(Utf16ToUtf8(m_Wide, m_Text.data()).written);
+            out.StringPart(m_Text);
+         }
+         break;
+
+      case Kind::Decoded:
+         break;
+   }
+
+   if (notNull)
+   {
+      open();   // empty value
+      out.EndString();
+   }
+   else
+   {
+      out.Raw("null");
+   }
+}
+
+const json::value& LongDataWriter::Decode(nanodbc::result& row, short col)
+{
+   try
+   {
+      m_Decoder.DecodeColumn(row, col, m_Value);
+   }
+   catch (std::exception& ex)
+   {
+      throw std::runtime_error(std::format("Error on column: {}, what: {}", m_Decoder.Key(col), ex.what()));
+   }
+   return m_Value;
+}
+
+void LongDataWriter::Pretty(nanodbc::result& row, JsonOutput& out, std::string& indent)
+{
+   // same layout as JsonOutput::Pretty of the decoded row, indented by 2
+   out.Raw("{\n");
+   indent.append(2, ' ');
+   for (short col = 0; col < m_Decoder.Columns(); col++)
+   {
+      if (col)
+         out.Raw(",\n");
+      out.Raw(indent);
+      out.String(m_Decoder.Key(col));
+      out.Raw(" : ");
+      if (m_Kinds[col] != Kind::Decoded)
+      {
+         WriteLong(row, col, out);
+         continue;
+      }
+      out.Pretty(Decode(row, col), indent);
+   }
+   out.Raw("\n");
+   indent.resize(indent.size() - 2);
+   out.Raw(indent);
+   out.Raw("}");
+   if (indent.empty())
+      out.Raw("\n");
+}
+
+void LongDataWriter::Compact(nanodbc::result& row, JsonOutput& out)
+{
+   out.Raw("{");
+   for (short col = 0; col < m_Decoder.Columns(); col++)
+   {
+      if (col)
+         out.Raw(",");
+      out.String(m_Decoder.Key(col));
+      out.Raw(":");
+      if (m_Kinds[col] != Kind::Decoded)
+      {
+         WriteLong(row, col, out);
+         continue;
+      }
+      out.Compact(Decode(row, col));
+   }
+   out.Raw("}");
+}
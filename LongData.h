@@ -0,0 +1,51 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <boost/json.hpp>
+#include <nanodbc/nanodbc.h>
+
+#include "CodePage.h"
+#include "Platform.h"
+#include "PrettyPrint.h"
+#include "RowDecoder.h"
+
+// long data columns (memo, blob) read in chunks with SQLGetData and written straight to the output:
+// a cell is never in memory as a whole. text is transcoded to utf-8 one chunk at a time,
+// blobs are written as base64 strings (Base64.h) instead of arrays of byte values.
+// the other columns are decoded by the RowDecoder, which should write blobs as base64 as well
+class LongDataWriter
+{
+   enum class Kind
+   {
+      Decoded,
+      Binary,
+      Narrow,   // code page text
+      Wide      // utf-16 text
+   };
+
+   const RowDecoder&  m_Decoder;
+   const CodePage&    m_CodePage;
+   std::vector<Kind>  m_Kinds;
+   std::vector<char>  m_Chunk;
+   std::u16string     m_Wide;   // utf-16 text of a chunk, after a surrogate left by the previous one
+   std::string        m_Text;   // chunk converted for the output
+   boost::json::value m_Value;
+
+   template <typename Fn>
+   bool ReadChunks(nanodbc::result& row, short col, SQLSMALLINT cType, size_t terminator, Fn&& fn);
+   void WriteLong(nanodbc::result& row, short col, JsonOutput& out);
+
+   const boost::json::value& Decode(nanodbc::result& row, short col);
+
+public:
+   // decoder is the one of result
+   LongDataWriter(nanodbc::result& result, const RowDecoder& decoder, const CodePage& codePage);
+
+   bool HasLongData() const;
+
+   // the current row, in the layout of JsonOutput::Pretty at indent, or of JsonOutput::Compact
+   void Pretty(nanodbc::result& row, JsonOutput& out, std::string& indent);
+   void Compact(nanodbc::result& row, JsonOutput& out);
+};
@@ -0,0 +1,162 @@
+#include "MappedFile.h"
+
+#include <cstdio>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+
+#if defined(_WIN32)
+   #include <fcntl.h>
+   #include <io.h>
+   #include <windows.h>
+#else
+   #include <fcntl.h>
+   #include <sys/mman.h>
+   #include <sys/stat.h>
+   #include <unistd.h>
+#endif
+
+namespace
+{
+   constexpr size_t read_block = 1024 * 1024;
+
+   void ReadStream(std::istream& input, std::string& buffer)
+   {
+      size_t size {0};
+      while (input)
+      {
+         buffer.resize(size + read_block);
+         input.read(buffer.data() + size, read_block);
+         size += static_cast<size_t>(input.gcount());
+      }
+      buffer.resize(size);
+   }
+}   // namespace
+
+MappedFile::MappedFile(const std::string& filename)
+{
+   if (filename == "-")
+   {
+      ReadAll(filename);
+      return;
+   }
+
+#if defined(_WIN32)
+   HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+   if (file == INVALID_HANDLE_VALUE)
+      throw std::runtime_error(std::format("can't open snapshot: {}", filename));
+   m_File = file;
+
+   LARGE_INTEGER size {};
+   if (GetFileType(file) != FILE_TYPE_DISK || !GetFileSizeEx(file, &size) || size.QuadPart == 0)
+   {
+      Unmap();
+      ReadAll(filename);
+      return;
+   }
+
+   m_Mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+   if (m_Mapping)
+      m_Mapped = static_cast<const char*>(MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0));
+   if (!m_Mapped)
+   {
+      Unmap();
+      ReadAll(filename);
+      return;
+   }
+   m_Size = static_cast<size_t>(size.QuadPart);
+#else
+   int fd = open(filename.c_str(), O_RDONLY);
+   if (fd < 0)
+      throw std::runtime_error(std::format("can't open snapshot: {}", filename));
+
+   struct stat info {};
+   if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0)
+   {
+      void* mapped = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+      if (mapped != MAP_FAILED)
+      {
+         // read ahead aggressively, pages behind can be dropped
+         madvise(mapped, static_cast<size_t>(info.st_size), MADV_SEQUENTIAL);
+         m_Mapped = static_cast<const char*>(mapped);
+         m_Size   = static_cast<size_t>(info.st_size);
+      }
+   }
+   close(fd);
+   if (!m_Mapped)
+      ReadAll(filename);
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+   Unmap();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept :
+   m_Mapped(std::exchange(other.m_Mapped, nullptr)),
+   m_Size(std::exchange(other.m_Size, 0)),
+   m_File(std::exchange(other.m_File, nullptr)),
+   m_Mapping(std::exchange(other.m_Mapping, nullptr)),
+   m_Buffer(std::move(other.m_Buffer))
+{
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+   if (this != &other)
+   {
+      Unmap();
+      m_Mapped  = std::exchange(other.m_Mapped, nullptr);
+      m_Size    = std::exchange(other.m_Size, 0);
+      m_File    = std::exchange(other.m_File, nullptr);
+      m_Mapping = std::exchange(other.m_Mapping, nullptr);
+      m_Buffer  = std::move(other.m_Buffer);
+   }
+   return *this;
+}
+
+void MappedFile::Unmap()
+{
+#if defined(_WIN32)
+   if (m_Mapped)
+      UnmapViewOfFile(m_Mapped);
+   if (m_Mapping)
+      CloseHandle(m_Mapping);
+   if (m_File)
+      CloseHandle(m_File);
+#else
+   if (m_Mapped)
+      munmap(const_cast<char*>(m_Mapped), m_Size);
+#endif
+   m_Mapped  = nullptr;
+   m_Size    = 0;
+   m_File    = nullptr;
+   m_Mapping = nullptr;
+}
+
+void MappedFile::Close()
+{
+   Unmap();
+   std::string {}.swap(m_Buffer);
+}
+
+// pipes and stdin, in large blocks rather than through istreambuf_iterator
+void MappedFile::ReadAll(const std::string& filename)
+{
+   if (filename == "-")
+   {
+#if defined(_WIN32)
+      _setmode(_fileno(stdin), _O_BINARY);
+#endif
+      ReadStream(std::cin, m_Buffer);
+      return;
+   }
+
+   std::ifstream input(filename, std::ios::binary);
+   if (!input)
+      throw std::runtime_error(std::format("can't open snapshot: {}", filename));
+   ReadStream(input, m_Buffer);
+}
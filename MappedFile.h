@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// read only view of a whole file, shared by the tools to load snapshots.
+// a regular file is memory mapped and hinted for sequential access, the text is parsed
+// straight from the mapping and its pages can be dropped by the system once read.
+// pipes and stdin ("-") can't be mapped, they are read in large blocks into a buffer
+class MappedFile
+{
+   const char* m_Mapped {};
+   size_t      m_Size {};
+   void*       m_File {};      // windows file handle
+   void*       m_Mapping {};   // windows file mapping handle
+   std::string m_Buffer;       // not mapped
+
+   void Unmap();
+   void ReadAll(const std::string& filename);
+
+public:
+   MappedFile() = default;
+   explicit MappedFile(const std::string& filename);
+   ~MappedFile();
+
+   MappedFile(const MappedFile&)            = delete;
+   MappedFile& operator=(const MappedFile&) = delete;
+   MappedFile(MappedFile&& other) noexcept;
+   MappedFile& operator=(MappedFile&& other) noexcept;
+
+   std::string_view View() const { return m_Mapped ? std::string_view(m_Mapped, m_Size) : std::string_view(m_Buffer); }
+   bool             IsMapped() const { return m_Mapped != nullptr; }
+
+   // release the mapping or the buffer, ex: once the text is parsed
+   void Close();
+};
@@ -0,0 +1,66 @@
+#include "MemoryStats.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#if defined(_WIN32)
+   // clang-format off
+   #include <windows.h>
+   #include <psapi.h>
+   // clang-format on
+#else
+   #include <sys/resource.h>
+#endif
+
+namespace
+{
+   std::atomic<size_t> g_allocationCount {0};
+}   // namespace
+
+// counting replacement of the global allocation functions,
+// the array and nothrow versions end up here too
+void* operator new(std::size_t size)
+{
+   g_allocationCount.fetch_add(1, std::memory_order_relaxed);
+   if (size == 0)
+      size = 1;
+   for (;;)
+   {
+      if (auto p = std::malloc(size))
+         return p;
+      auto handler = std::get_new_handler();
+      if (!handler)
+         throw std::bad_alloc();
+      handler();
+   }
+}
+
+void operator delete(void* p) noexcept
+{
+   std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+   std::free(p);
+}
+
+size_t GetAllocationCount()
+{
+   return g_allocationCount.load(std::memory_order_relaxed);
+}
+
+size_t GetPeakMemory()
+{
+#if defined(_WIN32)
+   PROCESS_MEMORY_COUNTERS counters {};
+   if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+      return 0;
+   return counters.PeakWorkingSetSize;
+#else
+   rusage usage {};
+   getrusage(RUSAGE_SELF, &usage);
+   return static_cast<size_t>(usage.ru_maxrss) * 1024;   // in KB on linux
+#endif
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstddef>
+
+// process wide memory figures, reported with --timing to compare export modes
+
+// calls to the global operator new since the program started
+size_t GetAllocationCount();
+
+// peak resident memory of the process, in bytes
+size_t GetPeakMemory();
@@ -0,0 +1,133 @@
+#include "OrderedOutput.h"
+
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <streambuf>
+#include <vector>
+
+#include "Parallel.h"
+
+namespace
+{
+   using Write = std::function<void(std::string_view text)>;
+
+   // unbuffered, the producers buffer their text already (JsonOutput)
+   class WriteBuf : public std::streambuf
+   {
+      const Write& m_Write;
+
+   protected:
+      int_type overflow(int_type ch) override
+      {
+         if (!traits_type::eq_int_type(ch, traits_type::eof()))
+         {
+            auto c = traits_type::to_char_type(ch);
+            m_Write(std::string_view(&c, 1));
+         }
+         return traits_type::not_eof(ch);
+      }
+
+      std::streamsize xsputn(const char* s, std::streamsize count) override
+      {
+         if (count > 0)
+            m_Write(std::string_view(s, static_cast<size_t>(count)));
+         return count;
+      }
+
+   public:
+      explicit WriteBuf(const Write& write) :
+         m_Write(write) {}
+   };
+
+   // text of an item produced ahead of the output, removed once copied
+   class TempFile
+   {
+      std::filesystem::path m_Path;
+      std::fstream          m_File;
+
+   public:
+      TempFile()
+      {
+         std::random_device random;
+         m_Path = std::filesystem::temp_directory_path() / std::format("TlgAccess2Json-{:08x}{:08x}.tmp", random(), random());
+         m_File.open(m_Path, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+         if (!m_File)
+            throw std::runtime_error(std::format("can't create temporary file {}", m_Path.string()));
+      }
+
+      ~TempFile()
+      {
+         m_File.close();
+         std::error_code ec;
+         std::filesystem::remove(m_Path, ec);
+      }
+
+      TempFile(const TempFile&)            = delete;
+      TempFile& operator=(const TempFile&) = delete;
+
+      std::ostream& Stream() { return m_File; }
+
+      void CopyTo(const Write& write)
+      {
+         if (!m_File.flush())
+            throw std::runtime_error(std::format("can't write temporary file {}", m_Path.string()));
+         m_File.seekg(0);
+         std::vector<char> block(1 << 20);
+         while (m_File.read(block.data(), static_cast<std::streamsize>(block.size())) || m_File.gcount())
+            write(std::string_view(block.data(), static_cast<size_t>(m_File.gcount())));
+         if (m_File.bad())
+            throw std::runtime_error(std::format("can't read temporary file {}", m_Path.string()));
+      }
+   };
+}   // namespace
+
+void WriteOrdered(size_t count, size_t workers,
+                  const std::function<void(size_t index, std::ostream& os)>& produce,
+                  const std::function<void(size_t index)>&                   begin,
+                  const Write&                                               write)
+{
+   std::mutex                             mutex;
+   size_t                                 next {0};   // first item not written yet
+   std::vector<bool>                      done(count);
+   std::vector<std::unique_ptr<TempFile>> ahead(count);
+
+   ParallelFor(count, workers, [&](size_t idx)
+               {
+                  std::unique_lock lock(mutex);
+                  if (idx == next)
+                  {
+                     // nothing else is written until it is done
+                     lock.unlock();
+                     WriteBuf     buf(write);
+                     std::ostream os(&buf);
+                     os.exceptions(std::ios::badbit);   // rethrows what write throws
+                     begin(idx);
+                     produce(idx, os);
+                     lock.lock();
+                  }
+                  else
+                  {
+                     lock.unlock();
+                     auto file = std::make_unique<TempFile>();
+                     produce(idx, file->Stream());
+                     lock.lock();
+                     ahead[idx] = std::move(file);
+                  }
+
+                  // the items done after it are written in turn
+                  done[idx] = true;
+                  for (; next < count && done[next]; next++)
+                  {
+                     if (auto file = std::move(ahead[next]))
+                     {
+                        begin(next);
+                        file->CopyTo(write);
+                     }
+                  }
+               });
+}
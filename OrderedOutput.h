@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <ostream>
+#include <string_view>
+
+// text of items produced concurrently by up to workers threads (see ParallelFor), handed to write
+// in index order while the items after it are still being produced.
+// an item started once all the items before it are written goes straight to write from its
+// producer thread, after begin(index). an item started ahead of the output goes to a temporary file,
+// it is copied to write, after begin(index), by the thread which completes the item before it.
+// only one thread writes at a time and memory doesn't grow with the size of the items.
+// the first exception of produce or write is rethrown once the started items are done,
+// the output is then incomplete
+void WriteOrdered(size_t count, size_t workers,
+                  const std::function<void(size_t index, std::ostream& os)>& produce,
+                  const std::function<void(size_t index)>&                   begin,
+                  const std::function<void(std::string_view text)>&          write);
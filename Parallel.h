@@ -0,0 +1,50 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// run fn(index) for each index in [0, count) on up to workers threads, the calling thread included.
+// indexes are handed out in order. the first exception thrown stops handing out new indexes
+// and is rethrown once all threads are done
+template <typename Fn>
+void ParallelFor(size_t count, size_t workers, Fn&& fn)
+{
+   workers = std::clamp<size_t>(workers, 1, std::max<size_t>(count, 1));
+
+   std::atomic<size_t> next {0};
+   std::mutex          errorMutex;
+   std::exception_ptr  error;
+
+   auto worker = [&]()
+   {
+      for (size_t idx = next++; idx < count; idx = next++)
+      {
+         try
+         {
+            fn(idx);
+         }
+         catch (...)
+         {
+            std::lock_guard lock(errorMutex);
+            if (!error)
+               error = std::current_exception();
+            next = count;
+         }
+      }
+   };
+
+   {
+      std::vector<std::jthread> threads;
+      for (size_t i = 1; i < workers; i++)
+         threads.emplace_back(worker);
+      worker();
+   }
+
+   if (error)
+      std::rethrow_exception(error);
+}
@@ -1,5 +1,3 @@
-#include <locale>
-
 #if defined(_DLL)
    #error not ready for DLL
 #endif
@@ -19,4 +17,3 @@
 
 #endif
 
-std::locale& GetConsoleLoc();
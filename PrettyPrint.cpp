@@ -1,11 +1,28 @@
 #include "PrettyPrint.h"
 
+#include <bit>
+#include <charconv>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+   #include <emmintrin.h>
+   #define PRETTY_PRINT_SSE2
+#endif
+
 // removing some verbosity
 namespace json = boost::json;
 
 constexpr int json_indent = 2;
 
 void pretty_print(std::ostream& os, json::value const& jv, std::string* indent)
+{
+   std::string indent_;
+   if (!indent)
+      indent = &indent_;
+   JsonOutput out(os);
+   out.Pretty(jv, *indent);
+}
+
+void pretty_print_stream(std::ostream& os, json::value const& jv, std::string* indent)
 {
    std::string indent_;
    if (!indent)
@@ -23,7 +40,7 @@ void pretty_print(std::ostream& os, json::value const& jv, std::string* indent)
             for (;;)
             {
                os << *indent << json::serialize(it->key()) << " : ";
-               pretty_print(os, it->value(), indent);
+               pretty_print_stream(os, it->value(), indent);
                if (++it == obj.end())
                   break;
                os << ",\n";
@@ -46,7 +63,7 @@ void pretty_print(std::ostream& os, json::value const& jv, std::string* indent)
             for (;;)
             {
                os << *indent;
-               pretty_print(os, *it, indent);
+               pretty_print_stream(os, *it, indent);
                if (++it == arr.end())
                   break;
                os << ",\n";
@@ -91,3 +108,366 @@ void pretty_print(std::ostream& os, json::value const& jv, std::string* indent)
    if (indent->empty())
       os << "\n";
 }
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+   bool NeedsEscape(char c)
+   {
+      return c == '"' || c == '\\' || static_cast<unsigned char>(c) < 0x20;
+   }
+
+   // number of leading chars that can be copied as is, most strings have none to escape
+   size_t CleanPrefix(const char* p, const char* end)
+   {
+      const char* start = p;
+#if defined(PRETTY_PRINT_SSE2)
+      const __m128i quote     = _mm_set1_epi8('"');
+      const __m128i backslash = _mm_set1_epi8('\\');
+      const __m128i control   = _mm_set1_epi8(0x1f);
+      while (end - p >= 16)
+      {
+         __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+         // unsigned chunk <= 0x1f  <=>  min(chunk, 0x1f) == chunk
+         __m128i special = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)),
+                                        _mm_cmpeq_epi8(_mm_min_epu8(chunk, control), chunk));
+         if (auto mask = static_cast<unsigned>(_mm_movemask_epi8(special)))
+            return (p - start) + std::countr_zero(mask);
+         p += 16;
+      }
+#endif
+      while (p < end && !NeedsEscape(*p))
+         p++;
+      return p - start;
+   }
+
+   // same escapes as boost::json::serialize
+   void AppendEscaped(std::string& out, char c)
+   {
+      static constexpr char hex[] = "0123456789abcdef";
+      switch (c)
+      {
+         case '"':
+            out.append("\\\"");
+            break;
+         case '\\':
+            out.append("\\\\");
+            break;
+         case '\b':
+            out.append("\\b");
+            break;
+         case '\f':
+            out.append("\\f");
+            break;
+         case '\n':
+            out.append("\\n");
+            break;
+         case '\r':
+            out.append("\\r");
+            break;
+         case '\t':
+            out.append("\\t");
+            break;
+         default:
+            out.append("\\u00");
+            out.push_back(hex[(c >> 4) & 0xf]);
+            out.push_back(hex[c & 0xf]);
+            break;
+      }
+   }
+}   // namespace
+
+JsonOutput::~JsonOutput()
+{
+   try
+   {
+      Flush();
+   }
+   catch (...)
+   {
+   }
+}
+
+void JsonOutput::Flush()
+{
+   if (!m_Os || m_Out->empty())
+      return;
+   m_Os->write(m_Out->data(), m_Out->size());
+   m_Out->clear();
+}
+
+void JsonOutput::Escaped(std::string_view str)
+{
+   const char* p   = str.data();
+   const char* end = p + str.size();
+   while (p < end)
+   {
+      auto clean = CleanPrefix(p, end);
+      m_Out->append(p, clean);
+      p += clean;
+      if (p == end)
+         break;
+      AppendEscaped(*m_Out, *p++);
+   }
+}
+
+void JsonOutput::String(std::string_view str)
+{
+   m_Out->push_back('"');
+   Escaped(str);
+   m_Out->push_back('"');
+   CheckFlush();
+}
+
+void JsonOutput::Number(std::int64_t i)
+{
+   char buffer[24];
+   auto result = std::to_chars(buffer, buffer + sizeof(buffer), i);
+   m_Out->append(buffer, result.ptr);
+}
+
+void JsonOutput::Number(std::uint64_t u)
+{
+   char buffer[24];
+   auto result = std::to_chars(buffer, buffer + sizeof(buffer), u);
+   m_Out->append(buffer, result.ptr);
+}
+
+// std::ostream default for double is %g, 6 significant digits
+void JsonOutput::Number(double d)
+{
+   char buffer[32];
+   auto result = std::to_chars(buffer, buffer + sizeof(buffer), d, std::chars_format::general, 6);
+   m_Out->append(buffer, result.ptr);
+}
+
+void JsonOutput::PrettyObject(json::object const& obj, std::string& indent)
+{
+   m_Out->append("{\n");
+   indent.append(json_indent, ' ');
+   if (!obj.empty())
+   {
+      auto it = obj.begin();
+      for (;;)
+      {
+         m_Out->append(indent);
+         String(std::string_view(it->key().data(), it->key().size()));
+         m_Out->append(" : ");
+         PrettyValue(it->value(), indent);
+         if (++it == obj.end())
+            break;
+         m_Out->append(",\n");
+      }
+   }
+   m_Out->append("\n");
+   indent.resize(indent.size() - json_indent);
+   m_Out->append(indent);
+   m_Out->push_back('}');
+}
+
+void JsonOutput::PrettyArray(json::array const& arr, std::string& indent)
+{
+   m_Out->append("[\n");
+   indent.append(json_indent, ' ');
+   if (!arr.empty())
+   {
+      auto it = arr.begin();
+      for (;;)
+      {
+         m_Out->append(indent);
+         PrettyValue(*it, indent);
+         if (++it == arr.end())
+            break;
+         m_Out->append(",\n");
+      }
+   }
+   m_Out->append("\n");
+   indent.resize(indent.size() - json_indent);
+   m_Out->append(indent);
+   m_Out->push_back(']');
+}
+
+void JsonOutput::PrettyValue(json::value const& jv, std::string& indent)
+{
+   switch (jv.kind())
+   {
+      case json::kind::object:
+         PrettyObject(jv.get_object(), indent);
+         break;
+
+      case json::kind::array:
+         PrettyArray(jv.get_array(), indent);
+         break;
+
+      case json::kind::string:
+         String(std::string_view(jv.get_string().data(), jv.get_string().size()));
+         break;
+
+      case json::kind::uint64:
+         Number(jv.get_uint64());
+         break;
+
+      case json::kind::int64:
+         Number(jv.get_int64());
+         break;
+
+      case json::kind::double_:
+         Number(jv.get_double());
+         break;
+
+      case json::kind::bool_:
+         m_Out->append(jv.get_bool() ? "true" : "false");
+         break;
+
+      case json::kind::null:
+         m_Out->append("null");
+         break;
+   }
+   CheckFlush();
+}
+
+void JsonOutput::Pretty(json::value const& jv, std::string& indent)
+{
+   PrettyValue(jv, indent);
+   if (indent.empty())
+      m_Out->append("\n");
+   CheckFlush();
+}
+
+void JsonOutput::Pretty(json::object const& obj, std::string& indent)
+{
+   PrettyObject(obj, indent);
+   if (indent.empty())
+      m_Out->append("\n");
+   CheckFlush();
+}
+
+void JsonOutput::CompactValue(json::value const& jv)
+{
+   if (jv.is_object())
+   {
+      Compact(jv.get_object());
+      return;
+   }
+   if (jv.is_array())
+   {
+      m_Out->push_back('[');
+      for (auto it = jv.get_array().begin(); it != jv.get_array().end(); ++it)
+      {
+         if (it != jv.get_array().begin())
+            m_Out->push_back(',');
+         CompactValue(*it);
+      }
+      m_Out->push_back(']');
+      return;
+   }
+   std::string noIndent;
+   PrettyValue(jv, noIndent);
+}
+
+void JsonOutput::Compact(json::value const& jv)
+{
+   CompactValue(jv);
+   CheckFlush();
+}
+
+void JsonOutput::Compact(json::object const& obj)
+{
+   m_Out->push_back('{');
+   for (auto it = obj.begin(); it != obj.end(); ++it)
+   {
+      if (it != obj.begin())
+         m_Out->push_back(',');
+      String(std::string_view(it->key().data(), it->key().size()));
+      m_Out->push_back(':');
+      CompactValue(it->value());
+   }
+   m_Out->push_back('}');
+   CheckFlush();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// emit what pretty_print puts between elements, a value following its key stays on the same line
+void PrettyWriter::Separator()
+{
+   if (m_AfterKey)
+   {
+      m_AfterKey = false;
+      return;
+   }
+   if (m_First.empty())
+      return;
+   if (!m_First.back())
+      m_Out.Raw(",\n");
+   m_First.back() = false;
+   m_Out.Raw(m_Indent);
+}
+
+void PrettyWriter::Close(char closing)
+{
+   m_Out.Raw("\n");
+   m_Indent.resize(m_Indent.size() - json_indent);
+   m_Out.Raw(m_Indent);
+   m_Out.Raw(std::string_view(&closing, 1));
+   m_First.pop_back();
+   if (m_Indent.empty())
+      m_Out.Raw("\n");
+   if (m_First.empty())
+      m_Out.Flush();
+}
+
+void PrettyWriter::BeginObject()
+{
+   Separator();
+   m_Out.Raw("{\n");
+   m_Indent.append(json_indent, ' ');
+   m_First.push_back(true);
+}
+
+void PrettyWriter::EndObject()
+{
+   Close('}');
+}
+
+void PrettyWriter::BeginArray()
+{
+   Separator();
+   m_Out.Raw("[\n");
+   m_Indent.append(json_indent, ' ');
+   m_First.push_back(true);
+}
+
+void PrettyWriter::EndArray()
+{
+   Close(']');
+}
+
+void PrettyWriter::Key(json::string_view key)
+{
+   Separator();
+   m_Out.String(std::string_view(key.data(), key.size()));
+   m_Out.Raw(" : ");
+   m_AfterKey = true;
+}
+
+void PrettyWriter::Value(json::value const& jv)
+{
+   Separator();
+   m_Out.Pretty(jv, m_Indent);
+   if (m_First.empty())
+      m_Out.Flush();
+}
+
+void PrettyWriter::RawValue(std::string_view text)
+{
+   Separator();
+   m_Out.Raw(text);
+}
+
+JsonOutput& PrettyWriter::ValueOutput()
+{
+   Separator();
+   return m_Out;
+}
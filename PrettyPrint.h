@@ -1,6 +1,121 @@
 #pragma once
 #include <boost/json.hpp>
+#include <cstdint>
 #include <ostream>
 #include <string>
+#include <string_view>
+#include <vector>
 
 void pretty_print(std::ostream& os, boost::json::value const& jv, std::string* indent = nullptr);
+
+// the original std::ostream based version, kept as the reference of the format
+// (see PrettyPrintBench), pretty_print output must stay identical to it
+void pretty_print_stream(std::ostream& os, boost::json::value const& jv, std::string* indent = nullptr);
+
+// buffered json text output: text is accumulated in a large buffer and written to the stream in bulk.
+// strings are escaped like boost::json::serialize, numbers formatted like std::ostream does
+// in the "C" locale, without going through the stream
+class JsonOutput
+{
+   std::ostream* m_Os {};
+   std::string   m_Own;
+   std::string*  m_Out;
+   size_t        m_FlushSize {};
+
+   void PrettyObject(boost::json::object const& obj, std::string& indent);
+   void PrettyArray(boost::json::array const& arr, std::string& indent);
+   void PrettyValue(boost::json::value const& jv, std::string& indent);
+   void CompactValue(boost::json::value const& jv);
+   void Escaped(std::string_view str);
+
+   void CheckFlush()
+   {
+      if (m_Os && m_Out->size() >= m_FlushSize)
+         Flush();
+   }
+
+public:
+   explicit JsonOutput(std::ostream& os, size_t flushSize = 1 << 20) :
+      m_Os(&os), m_Out(&m_Own), m_FlushSize(flushSize) {}
+
+   // append to out, nothing is ever flushed
+   explicit JsonOutput(std::string& out) :
+      m_Out(&out) {}
+
+   ~JsonOutput();
+
+   JsonOutput(const JsonOutput&)            = delete;
+   JsonOutput& operator=(const JsonOutput&) = delete;
+
+   void Flush();
+
+   void Raw(std::string_view text)
+   {
+      m_Out->append(text);
+      CheckFlush();
+   }
+   void String(std::string_view str);   // quoted and escaped
+
+   // a string written in parts, ex: a column read in chunks. parts are escaped like String
+   void BeginString() { m_Out->push_back('"'); }
+   void StringPart(std::string_view str)
+   {
+      Escaped(str);
+      CheckFlush();
+   }
+   void EndString()
+   {
+      m_Out->push_back('"');
+      CheckFlush();
+   }
+   void Number(std::int64_t i);
+   void Number(std::uint64_t u);
+   void Number(double d);
+
+   // same layout as pretty_print, indent is the current indentation
+   void Pretty(boost::json::value const& jv, std::string& indent);
+   void Pretty(boost::json::object const& obj, std::string& indent);
+
+   // on a single line without spaces, ex: a row of an ndjson snapshot. scalars are written as by Pretty
+   void Compact(boost::json::value const& jv);
+   void Compact(boost::json::object const& obj);
+};
+
+// incremental version of pretty_print, the document is written as it is produced
+// so only the value currently being written has to be in memory.
+// output is identical to pretty_print on the equivalent DOM.
+// text is buffered, it is flushed when the outermost container is closed or by Flush()
+class PrettyWriter
+{
+   JsonOutput        m_Out;
+   std::string       m_Indent;
+   std::vector<bool> m_First;   // one entry per opened container
+   bool              m_AfterKey {};
+
+   void Separator();
+   void Close(char closing);
+
+public:
+   explicit PrettyWriter(std::ostream& os) :
+      m_Out(os) {}
+
+   // write a fragment that will be nested at indent in another document, see RawValue
+   PrettyWriter(std::ostream& os, std::string indent) :
+      m_Out(os), m_Indent(std::move(indent)) {}
+
+   const std::string& Indent() const { return m_Indent; }
+
+   void BeginObject();
+   void EndObject();
+   void BeginArray();
+   void EndArray();
+
+   void Key(boost::json::string_view key);
+   void Value(boost::json::value const& jv);
+   void RawValue(std::string_view text);   // value already written by a writer at Indent()
+
+   // the next value is written by the caller, ex: JsonOutput::Pretty at Indent() or a string in parts
+   JsonOutput& ValueOutput();
+
+   void Flush() { m_Out.Flush(); }
+};
@@ -0,0 +1,145 @@
+/* Copyright(c) Jada Informatique 2021.
+
+Jada Informatique Software License - Version 1.0 - june 27th, 2021
+
+Permission is hereby granted, free of charge, to any person or organization
+obtaining a copy of the software and accompanying documentation covered by
+this license (the "Software") to use, reproduce, display, distribute,
+execute, and transmit the Software, and to prepare derivative works of the
+Software, and to permit third-parties to whom the Software is furnished to
+do so, all subject to the following:
+
+The copyright notices in the Software and this entire statement, including
+the above license grant, this restriction and the following disclaimer,
+must be included in all copies of the Software, in whole or in part, and
+all derivative works of the Software, unless such copies or derivative
+works are solely in the form of machine-executable object code generated by
+a source language processor.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+// times pretty_print against the original ostream based printer on a snapshot
+// and checks both produce the same bytes, output goes to a hashing sink so only the printers are measured
+
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <streambuf>
+
+#include <boost/json.hpp>
+
+#include "CmdLine.h"
+#include "PrettyPrint.h"
+
+namespace json = boost::json;
+
+// counts and hashes (FNV-1a) what is written, nothing is kept
+class HashingBuf : public std::streambuf
+{
+   std::uint64_t m_Hash {14695981039346656037ull};
+   std::uint64_t m_Size {};
+
+   void Add(char c)
+   {
+      m_Hash ^= static_cast<std::uint8_t>(c);
+      m_Hash *= 1099511628211ull;
+   }
+
+protected:
+   int_type overflow(int_type ch) override
+   {
+      if (!traits_type::eq_int_type(ch, traits_type::eof()))
+      {
+         Add(traits_type::to_char_type(ch));
+         m_Size++;
+      }
+      return traits_type::not_eof(ch);
+   }
+
+   std::streamsize xsputn(const char* s, std::streamsize count) override
+   {
+      for (std::streamsize idx = 0; idx < count; idx++)
+         Add(s[idx]);
+      m_Size += count;
+      return count;
+   }
+
+public:
+   std::uint64_t Hash() const { return m_Hash; }
+   std::uint64_t Size() const { return m_Size; }
+};
+
+struct BenchResult
+{
+   std::uint64_t hash {};
+   std::uint64_t size {};
+   double        seconds {};
+};
+
+template<typename Printer>
+BenchResult Run(const json::value& jv, size_t iterations, Printer&& printer)
+{
+   BenchResult result;
+   auto        start = std::chrono::steady_clock::now();
+   for (size_t idx = 0; idx < iterations; idx++)
+   {
+      HashingBuf   sink;
+      std::ostream os(&sink);
+      printer(os, jv);
+      os.flush();
+      result.hash = sink.Hash();
+      result.size = sink.Size();
+   }
+   result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+   return result;
+}
+
+void Report(const char* name, const BenchResult& result, size_t iterations)
+{
+   auto mb = static_cast<double>(result.size) * iterations / (1024.0 * 1024.0);
+   std::cout << std::format("{:<14} {:>10} bytes  {:8.3f}s  {:8.1f} MB/s", name, result.size, result.seconds, result.seconds > 0 ? mb / result.seconds : 0.0) << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+   try
+   {
+      CmdLine cmdLine(argc, argv);
+      if (cmdLine.Positional().size() != 1)
+      {
+         std::cerr << "usage: PrettyPrintBench snapshot.json [--iterations=n]" << std::endl;
+         return 1;
+      }
+
+      std::ifstream input(cmdLine.Positional()[0], std::ios::binary);
+      std::string   text((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+      auto          jv         = json::parse(text);
+      auto          iterations = cmdLine.GetSize("iterations", 5);
+
+      auto reference = Run(jv, iterations, [](std::ostream& os, const json::value& jv) { pretty_print_stream(os, jv); });
+      auto buffered  = Run(jv, iterations, [](std::ostream& os, const json::value& jv) { pretty_print(os, jv); });
+      Report("ostream", reference, iterations);
+      Report("pretty_print", buffered, iterations);
+
+      if (reference.hash != buffered.hash || reference.size != buffered.size)
+      {
+         std::cerr << "output differs from the reference printer" << std::endl;
+         return 2;
+      }
+   }
+   catch (const std::exception& e)
+   {
+      std::cerr << e.what() << '\n';
+      return 1;
+   }
+   return 0;
+}
@@ -0,0 +1,321 @@
+#include "RowDecoder.h"
+
+#include <format>
+#include <stdexcept>
+#include <tuple>
+
+#include "Base64.h"
+#include "Platform.h"
+#include "utf8Conversion.h"
+
+namespace json = boost::json;
+
+// json uses utf8, database has a mixture of wide, utf8 and code page string
+// narrow strings are in the code page given to the decoder, CP1252 for MsAccess
+
+namespace
+{
+   // fetchers convert a non NULL value
+   using Fetcher = void (*)(nanodbc::result& row, short col, const CodePage& codePage, json::value& jv);
+
+   void FetchBlob(nanodbc::result& row, short col, const CodePage&, json::value& jv)
+   {
+      jv = json::value_from(row.get<std::vector<uint8_t>>(col));
+   }
+
+   void BytesToBase64(std::string_view bytes, json::value& jv)
+   {
+      auto& str = jv.emplace_string();
+      str.resize(Base64EncodedSize(bytes.size()));
+      Base64Encode(bytes.data(), bytes.size(), str.data());
+   }
+
+   void FetchBlobBase64(nanodbc::result& row, short col, const CodePage&, json::value& jv)
+   {
+      auto blob = row.get<std::vector<uint8_t>>(col);
+      BytesToBase64(std::string_view(reinterpret_cast<const char*>(blob.data()), blob.size()), jv);
+   }
+
+   void NarrowToJson(std::string_view text, const CodePage& codePage, json::value& jv)
+   {
+      auto& str = jv.emplace_string();
+      str.resize(CodePage::MaxToUtf8Size(text.size()));
+      str.resize(codePage.ToUtf8(text, str.data()).written);
+   }
+
+   void WideToJson(std::u16string_view text, json::value& jv)
+   {
+      auto& str = jv.emplace_string();
+      str.resize(MaxUtf16ToUtf8Size(text.size()));
+      str.resize(Utf16ToUtf8(text, str.data()).written);
+   }
+
+   // for MsAccess, SQL_CHAR is CP1252,
+   // Json is utf8 !!
+   // code page text is fetched in a reused buffer and transcoded straight into the json string
+   void FetchNarrow(nanodbc::result& row, short col, const CodePage& codePage, json::value& jv)
+   {
+      thread_local std::string text;
+      row.get_ref(col, text);
+      NarrowToJson(text, codePage, jv);
+   }
+
+   // SQLWCHAR is utf-16, fetched in a reused buffer and transcoded straight into the json string
+   void FetchWide(nanodbc::result& row, short col, const CodePage&, json::value& jv)
+   {
+      static_assert(sizeof(nanodbc::wide_string::value_type) == sizeof(char16_t));
+
+      thread_local nanodbc::wide_string text;
+      row.get_ref(col, text);
+      WideToJson(std::u16string_view(reinterpret_cast<const char16_t*>(text.data()), text.size()), jv);
+   }
+
+   void FetchInteger(nanodbc::result& row, short col, const CodePage&, json::value& jv)
+   {
+      jv = row.get<std::int64_t>(col);
+   }
+
+   void FetchDouble(nanodbc::result& row, short col, const CodePage&, json::value& jv)
+   {
+      jv = row.get<double>(col);
+   }
+
+   // for now, other types, ask odbc to get their string representation
+   // will need to be fixed as needs arise!
+   void FetchAsText(nanodbc::result& row, short col, const CodePage& codePage, json::value& jv)
+   {
+      FetchNarrow(row, col, codePage, jv);
+   }
+
+   // only when the row is bound can we test for NULL before fetching!
+   template <Fetcher fetch>
+   void DecodeBound(nanodbc::result& row, short col, const CodePage& codePage, json::value& jv)
+   {
+      if (row.is_null(col))
+         jv = nullptr;
+      else
+         fetch(row, col, codePage, jv);
+   }
+
+   // unbound (long) data can only be tested for null once fetched,
+   // without the test a NULL column would be converted to empty string!!!
+   template <Fetcher fetch>
+   void DecodeUnbound(nanodbc::result& row, short col, const CodePage& codePage, json::value& jv)
+   {
+      fetch(row, col, codePage, jv);
+      if (row.is_null(col))
+         jv = nullptr;
+   }
+
+   // copiers and converters: FetchXxx split in two for RowDecoder::CopyRow and ConvertRow
+   using Copier    = RowDecoder::Copier;
+   using Converter = RowDecoder::Converter;
+   using RawValue  = RowDecoder::RawValue;
+
+   void CopyBlob(nanodbc::result& row, short col, RawValue& raw)
+   {
+      auto blob = row.get<std::vector<uint8_t>>(col);
+      raw.bytes.assign(blob.begin(), blob.end());
+   }
+
+   void CopyNarrow(nanodbc::result& row, short col, RawValue& raw)
+   {
+      row.get_ref(col, raw.bytes);
+   }
+
+   void CopyWide(nanodbc::result& row, short col, RawValue& raw)
+   {
+      thread_local nanodbc::wide_string text;
+      row.get_ref(col, text);
+      raw.bytes.assign(reinterpret_cast<const char*>(text.data()), text.size() * sizeof(char16_t));
+   }
+
+   void CopyInteger(nanodbc::result& row, short col, RawValue& raw)
+   {
+      raw.integer = row.get<std::int64_t>(col);
+   }
+
+   void CopyDouble(nanodbc::result& row, short col, RawValue& raw)
+   {
+      raw.real = row.get<double>(col);
+   }
+
+   void ConvertBlob(const RawValue& raw, const CodePage&, json::value& jv)
+   {
+      jv = json::value_from(std::vector<uint8_t>(raw.bytes.begin(), raw.bytes.end()));
+   }
+
+   void ConvertBlobBase64(const RawValue& raw, const CodePage&, json::value& jv)
+   {
+      BytesToBase64(raw.bytes, jv);
+   }
+
+   void ConvertNarrow(const RawValue& raw, const CodePage& codePage, json::value& jv)
+   {
+      NarrowToJson(raw.bytes, codePage, jv);
+   }
+
+   void ConvertWide(const RawValue& raw, const CodePage&, json::value& jv)
+   {
+      // bytes came from a char16_t buffer, std::string storage is suitably aligned
+      WideToJson(std::u16string_view(reinterpret_cast<const char16_t*>(raw.bytes.data()), raw.bytes.size() / sizeof(char16_t)), jv);
+   }
+
+   void ConvertInteger(const RawValue& raw, const CodePage&, json::value& jv)
+   {
+      jv = raw.integer;
+   }
+
+   void ConvertDouble(const RawValue& raw, const CodePage&, json::value& jv)
+   {
+      jv = raw.real;
+   }
+
+   // same NULL rules as DecodeBound and DecodeUnbound
+   template <Copier copy>
+   void CopyBound(nanodbc::result& row, short col, RawValue& raw)
+   {
+      raw.null = row.is_null(col);
+      if (!raw.null)
+         copy(row, col, raw);
+   }
+
+   template <Copier copy>
+   void CopyUnbound(nanodbc::result& row, short col, RawValue& raw)
+   {
+      copy(row, col, raw);
+      raw.null = row.is_null(col);
+   }
+
+   struct Codec
+   {
+      RowDecoder::Decoder decode;
+      Copier              copy;
+      Converter           convert;
+   };
+
+   template <Fetcher fetch, Copier copy, Converter convert>
+   Codec Select(bool bound)
+   {
+      if (bound)
+         return {&DecodeBound<fetch>, &CopyBound<copy>, convert};
+      return {&DecodeUnbound<fetch>, &CopyUnbound<copy>, convert};
+   }
+
+   Codec ResolveCodec(int sqlType, bool bound, BlobFormat blobs)
+   {
+      // for string conversion, msaccess uses:
+      // HKEY_LOCAL_MACHINE\SYSTEM\CurrentControlSet\Control\Nls\CodePage
+      // which in tmx case is codepage 1252
+      switch (sqlType)
+      {
+         case SQL_LONGVARBINARY:
+            if (blobs == BlobFormat::Base64)
+               return Select<FetchBlobBase64, CopyBlob, ConvertBlobBase64>(bound);
+            return Select<FetchBlob, CopyBlob, ConvertBlob>(bound);
+
+         case SQL_VARCHAR:
+         case SQL_CHAR:
+         case SQL_LONGVARCHAR:
+            return Select<FetchNarrow, CopyNarrow, ConvertNarrow>(bound);
+
+         // we have unicode!
+         case SQL_WCHAR:
+         case SQL_WVARCHAR:
+         case SQL_WLONGVARCHAR:
+            return Select<FetchWide, CopyWide, ConvertWide>(bound);
+
+         case SQL_BIGINT:
+         case SQL_TINYINT:
+         case SQL_INTEGER:
+         case SQL_SMALLINT:
+            return Select<FetchInteger, CopyInteger, ConvertInteger>(bound);
+
+         case SQL_FLOAT:
+         case SQL_REAL:
+         case SQL_DOUBLE:
+            return Select<FetchDouble, CopyDouble, ConvertDouble>(bound);
+
+         case SQL_NUMERIC:
+         case SQL_DECIMAL:
+         default:
+            return Select<FetchAsText, CopyNarrow, ConvertNarrow>(bound);
+      }
+   }
+
+   // bad columns are all reported in the exception
+   template <typename Fn>
+   json::object BuildRow(const RowDecoder& decoder, json::storage_ptr sp, Fn&& decodeColumn)
+   {
+      json::object                                rowData(std::move(sp));
+      std::vector<std::tuple<short, std::string>> badCols;
+
+      rowData.reserve(decoder.Columns());
+      for (short colIdx = 0; colIdx < decoder.Columns(); colIdx++)
+      {
+         auto& jsonValue = rowData[decoder.Key(colIdx)];
+         try
+         {
+            decodeColumn(colIdx, jsonValue);
+         }
+         catch (std::exception& ex)
+         {
+            badCols.push_back(std::make_tuple(colIdx, ex.what()));
+         }
+      }
+      // if we got bad cols, report them
+      if (!badCols.empty())
+      {
+         std::string errorMsg = std::format("bad row: [{}]", json::serialize(rowData));
+         for (auto badCol: badCols)
+            errorMsg += std::format("\nError on column: {}, what: {}", decoder.Key(std::get<0>(badCol)), std::get<1>(badCol));
+         throw std::runtime_error(errorMsg);
+      }
+
+      return rowData;
+   }
+}   // namespace
+
+RowDecoder::RowDecoder(nanodbc::result& result, const CodePage& codePage, BlobFormat blobs) :
+   m_CodePage(&codePage)
+{
+   m_Columns.reserve(result.columns());
+   for (short col = 0; col < result.columns(); col++)
+   {
+      auto codec = ResolveCodec(result.column_datatype(col), result.is_bound(col), blobs);
+      m_Columns.push_back({result.column_name(col), codec.decode, codec.copy, codec.convert});
+   }
+}
+
+json::object RowDecoder::DecodeRow(nanodbc::result& row, json::storage_ptr sp) const
+{
+   return BuildRow(*this, std::move(sp), [&](short colIdx, json::value& jv)
+                   { DecodeColumn(row, colIdx, jv); });
+}
+
+// fetch errors are thrown here, without the row: it is not converted yet
+void RowDecoder::CopyRow(nanodbc::result& row, RawValue* values) const
+{
+   for (short colIdx = 0; colIdx < Columns(); colIdx++)
+   {
+      try
+      {
+         m_Columns[colIdx].copy(row, colIdx, values[colIdx]);
+      }
+      catch (std::exception& ex)
+      {
+         throw std::runtime_error(std::format("Error on column: {}, what: {}", Key(colIdx), ex.what()));
+      }
+   }
+}
+
+json::object RowDecoder::ConvertRow(const RawValue* values, json::storage_ptr sp) const
+{
+   return BuildRow(*this, std::move(sp), [&](short colIdx, json::value& jv)
+                   {
+                      if (values[colIdx].null)
+                         jv = nullptr;
+                      else
+                         m_Columns[colIdx].convert(values[colIdx], *m_CodePage, jv);
+                   });
+}
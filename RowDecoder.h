@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <boost/json.hpp>
+#include <nanodbc/nanodbc.h>
+
+#include "CodePage.h"
+
+// how SQL_LONGVARBINARY values are written in json
+enum class BlobFormat
+{
+   Array,    // array of byte values
+   Base64    // string, see Base64.h
+};
+
+// conversion plan from a result set row to json, built once per nanodbc::result.
+// column names, SQL type dispatch and NULL handling are resolved up front,
+// converting a row only runs the converter of each column
+class RowDecoder
+{
+public:
+   using Decoder = void (*)(nanodbc::result& row, short col, const CodePage& codePage, boost::json::value& jv);
+
+   // a column value copied out of the result set as the driver returned it:
+   // code page or utf-16 text and blobs are bytes, converted later, maybe on another thread
+   struct RawValue
+   {
+      bool         null {};
+      std::int64_t integer {};
+      double       real {};
+      std::string  bytes;   // capacity is kept when the value is reused
+   };
+   using Copier    = void (*)(nanodbc::result& row, short col, RawValue& raw);
+   using Converter = void (*)(const RawValue& raw, const CodePage& codePage, boost::json::value& jv);
+
+private:
+   struct Column
+   {
+      std::string key;
+      Decoder     decode;
+      Copier      copy;
+      Converter   convert;
+   };
+   std::vector<Column> m_Columns;
+   const CodePage*     m_CodePage;
+
+public:
+   // codePage is the one of the database narrow strings
+   explicit RowDecoder(nanodbc::result& result, const CodePage& codePage = CodePage::Cp1252(), BlobFormat blobs = BlobFormat::Array);
+
+   short              Columns() const { return static_cast<short>(m_Columns.size()); }
+   const std::string& Key(short col) const { return m_Columns[col].key; }
+
+   // convert one column of the current row, throws on conversion error
+   void DecodeColumn(nanodbc::result& row, short col, boost::json::value& jv) const
+   {
+      m_Columns[col].decode(row, col, *m_CodePage, jv);
+   }
+
+   // convert the current row, bad columns are all reported in the exception.
+   // values are allocated from sp, ex: an arena released once the row is written
+   boost::json::object DecodeRow(nanodbc::result& row, boost::json::storage_ptr sp = {}) const;
+
+   // DecodeRow in two steps, see ExportPipeline.h: the current row is copied to Columns() values,
+   // the result set can then move on while the copy is converted
+   void                CopyRow(nanodbc::result& row, RawValue* values) const;
+   boost::json::object ConvertRow(const RawValue* values, boost::json::storage_ptr sp = {}) const;
+};
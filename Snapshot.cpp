@@ -0,0 +1,869 @@
+#include "Snapshot.h"
+
+#include <algorithm>
+#include <bit>
+#include <exception>
+#include <format>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <boost/json/basic_parser_impl.hpp>
+
+#include "Parallel.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+   #include <emmintrin.h>
+   #define SNAPSHOT_SSE2
+#endif
+
+namespace json = boost::json;
+
+TableRows::TableRows(const json::value& table)
+{
+   if (table.is_object())
+      m_Columns.emplace(table.get_object());
+   else
+      m_Rows = &table.as_array();
+}
+
+size_t TableRows::size() const
+{
+   if (m_Rows)
+      return m_Rows->size();
+   if (m_Columns)
+      return m_Columns->size();
+   return m_Binary->size();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+   // depth of the containers, once opened
+   constexpr size_t document_depth = 1;
+   constexpr size_t schema_depth   = 2;   // TlgSchema object
+   constexpr size_t table_depth    = 3;   // array of rows, or structure of array object
+   constexpr size_t row_depth      = 4;
+
+   // written by TlgAccess2Json --delta, read by DeltaSnapshot only
+   constexpr std::string_view delta_key        = "TlgDelta";
+   constexpr std::string_view delta_error      = "a TlgDelta snapshot only holds the changed rows, a full snapshot is expected (JSon2Access applies a delta with --delta)";
+   constexpr std::string_view delta_sections[] = {"inserted", "updated", "deleted"};
+
+   // basic_parser handler: builds one row (or one structure of array table) at a time
+   // in a value_stack, everything outside TlgSchema is skipped
+   class SnapshotHandler
+   {
+      const SnapshotVisitor&   m_Visitor;
+      json::monotonic_resource m_Arena;   // values being built, released once handed over
+      json::value_stack        m_Stack;
+      size_t                   m_Depth {};
+      size_t                   m_CaptureDepth {};   // 0: not building a value
+      size_t                   m_SkipDepth {};      // 0: not skipping
+      bool                     m_InSchema {};
+      std::string              m_Key;
+      std::string              m_TableName;
+      std::exception_ptr       m_Exception;
+
+      bool Capturing() const { return m_CaptureDepth != 0; }
+
+      // exceptions can't go through the parser, they are rethrown by Rethrow()
+      template <typename Fn>
+      bool Guard(json::error_code& ec, Fn&& fn)
+      {
+         try
+         {
+            fn();
+            return true;
+         }
+         catch (...)
+         {
+            m_Exception = std::current_exception();
+            ec          = json::error::exception;
+            return false;
+         }
+      }
+
+      void StartCapture()
+      {
+         m_Stack.reset(json::storage_ptr(&m_Arena));
+         m_CaptureDepth = m_Depth;
+      }
+
+      // the container holding the captured value is closed
+      void EndCapture()
+      {
+         auto value     = m_Stack.release();
+         m_CaptureDepth = 0;
+         if (value.is_object() && m_Depth == row_depth)
+         {
+            m_Visitor.row(value.get_object());
+         }
+         else
+         {
+            // structure of array table
+            m_Visitor.beginTable(m_TableName);
+            TableRows(value).ForEach(m_Visitor.row);
+            m_Visitor.endTable(m_TableName);
+         }
+         value = nullptr;
+         m_Arena.release();
+      }
+
+      // a container opens, m_Depth is its depth
+      void Open(bool isObject)
+      {
+         if (m_SkipDepth || Capturing())
+            return;
+         if (m_Depth < schema_depth)
+            return;
+         if (m_Depth == schema_depth)
+         {
+            if (!m_InSchema)
+               m_SkipDepth = m_Depth;
+            return;
+         }
+         if (m_Depth == table_depth)
+         {
+            if (isObject)
+               StartCapture();
+            else
+               m_Visitor.beginTable(m_TableName);
+            return;
+         }
+         if (m_Depth == row_depth && isObject)
+         {
+            StartCapture();
+            return;
+         }
+         throw std::runtime_error(std::format("unexpected content in table {}", m_TableName));
+      }
+
+      // a container closes, m_Depth is still its depth
+      void Close(bool isObject, size_t size)
+      {
+         if (m_SkipDepth)
+         {
+            if (m_Depth == m_SkipDepth)
+               m_SkipDepth = 0;
+            return;
+         }
+         if (Capturing())
+         {
+            if (isObject)
+               m_Stack.push_object(size);
+            else
+               m_Stack.push_array(size);
+            if (m_Depth == m_CaptureDepth)
+               EndCapture();
+            return;
+         }
+         if (m_Depth == table_depth)
+            m_Visitor.endTable(m_TableName);
+      }
+
+      // a scalar outside of a row: only the schema is looked at
+      void CheckScalar()
+      {
+         if (!m_SkipDepth && m_Depth >= table_depth)
+            throw std::runtime_error(std::format("unexpected value in table {}", m_TableName));
+      }
+
+   public:
+      static constexpr std::size_t max_object_size = std::size_t(-1);
+      static constexpr std::size_t max_array_size  = std::size_t(-1);
+      static constexpr std::size_t max_key_size    = std::size_t(-1);
+      static constexpr std::size_t max_string_size = std::size_t(-1);
+
+      explicit SnapshotHandler(const SnapshotVisitor& visitor) :
+         m_Visitor(visitor) {}
+
+      void Rethrow()
+      {
+         if (m_Exception)
+            std::rethrow_exception(std::exchange(m_Exception, nullptr));
+      }
+
+      bool on_document_begin(json::error_code&) { return true; }
+      bool on_document_end(json::error_code&) { return true; }
+
+      bool on_object_begin(json::error_code& ec)
+      {
+         m_Depth++;
+         return Guard(ec, [&] { Open(true); });
+      }
+      bool on_object_end(std::size_t n, json::error_code& ec)
+      {
+         auto ok = Guard(ec, [&] { Close(true, n); });
+         m_Depth--;
+         return ok;
+      }
+      bool on_array_begin(json::error_code& ec)
+      {
+         m_Depth++;
+         return Guard(ec, [&] { Open(false); });
+      }
+      bool on_array_end(std::size_t n, json::error_code& ec)
+      {
+         auto ok = Guard(ec, [&] { Close(false, n); });
+         m_Depth--;
+         return ok;
+      }
+
+      bool on_key_part(json::string_view s, std::size_t, json::error_code&)
+      {
+         if (Capturing())
+            m_Stack.push_chars(s);
+         else if (!m_SkipDepth)
+            m_Key.append(s.data(), s.size());
+         return true;
+      }
+      bool on_key(json::string_view s, std::size_t, json::error_code& ec)
+      {
+         if (Capturing())
+         {
+            m_Stack.push_key(s);
+         }
+         else if (!m_SkipDepth)
+         {
+            m_Key.append(s.data(), s.size());
+            if (m_Depth == document_depth && m_Key == delta_key)
+               return Guard(ec, [] { throw std::runtime_error(std::string(delta_error)); });
+            if (m_Depth == document_depth)
+               m_InSchema = m_Key == "TlgSchema";
+            else
+               m_TableName = m_Key;
+            m_Key.clear();
+         }
+         return true;
+      }
+
+      bool on_string_part(json::string_view s, std::size_t, json::error_code&)
+      {
+         if (Capturing())
+            m_Stack.push_chars(s);
+         return true;
+      }
+      bool on_string(json::string_view s, std::size_t, json::error_code& ec)
+      {
+         if (Capturing())
+         {
+            m_Stack.push_string(s);
+            return true;
+         }
+         return Guard(ec, [&] { CheckScalar(); });
+      }
+
+      bool on_number_part(json::string_view, json::error_code&) { return true; }
+
+      bool on_int64(std::int64_t i, json::string_view, json::error_code& ec)
+      {
+         if (Capturing())
+         {
+            m_Stack.push_int64(i);
+            return true;
+         }
+         return Guard(ec, [&] { CheckScalar(); });
+      }
+      bool on_uint64(std::uint64_t u, json::string_view, json::error_code& ec)
+      {
+         if (Capturing())
+         {
+            m_Stack.push_uint64(u);
+            return true;
+         }
+         return Guard(ec, [&] { CheckScalar(); });
+      }
+      bool on_double(double d, json::string_view, json::error_code& ec)
+      {
+         if (Capturing())
+         {
+            m_Stack.push_double(d);
+            return true;
+         }
+         return Guard(ec, [&] { CheckScalar(); });
+      }
+      bool on_bool(bool b, json::error_code& ec)
+      {
+         if (Capturing())
+         {
+            m_Stack.push_bool(b);
+            return true;
+         }
+         return Guard(ec, [&] { CheckScalar(); });
+      }
+      bool on_null(json::error_code& ec)
+      {
+         if (Capturing())
+         {
+            m_Stack.push_null();
+            return true;
+         }
+         return Guard(ec, [&] { CheckScalar(); });
+      }
+
+      bool on_comment_part(json::string_view, json::error_code&) { return true; }
+      bool on_comment(json::string_view, json::error_code&) { return true; }
+   };
+
+   void CheckParser(json::basic_parser<SnapshotHandler>& parser, const json::error_code& ec)
+   {
+      parser.handler().Rethrow();
+      if (ec)
+         throw std::system_error(ec);
+   }
+}   // namespace
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+   // whole rows: lines of an ndjson snapshot, or comma separated rows of a json table array.
+   // a view of the mapping or a block read from a stream
+   struct TextChunk
+   {
+      std::string                owned;
+      std::string_view           view;
+      std::optional<std::string> table;      // json table array beginning with this chunk
+      bool                       commas {};  // rows of a json array, cut after a comma unless table
+
+      std::string_view Text() const { return owned.empty() ? view : std::string_view(owned); }
+   };
+
+   // the rows of a chunk once parsed, allocated from the arena of the chunk
+   struct ParsedChunk
+   {
+      std::unique_ptr<json::monotonic_resource> arena = std::make_unique<json::monotonic_resource>();
+      std::optional<std::string>                table;
+      std::vector<json::value>                  lines;
+   };
+
+   // values one after the other, separated by blanks (ndjson) or by exactly one comma (json array).
+   // a chunk cut after a comma must hold a row, only the first chunk of an array can be empty
+   ParsedChunk ParseChunk(const TextChunk& chunk)
+   {
+      constexpr std::string_view blanks = " \t\r\n";
+
+      ParsedChunk  parsed;
+      json::parser parser;
+      auto         text = chunk.Text();
+      parsed.table      = chunk.table;
+      for (;;)
+      {
+         auto start = text.find_first_not_of(blanks);
+         if (start == std::string_view::npos)
+            break;
+         text.remove_prefix(start);
+         if (chunk.commas && !parsed.lines.empty())
+         {
+            if (text.front() != ',')
+               throw std::runtime_error("json snapshot rows not separated by a comma");
+            start = text.find_first_not_of(blanks, 1);
+            if (start == std::string_view::npos)
+               throw std::runtime_error("json snapshot table ends with a comma");
+            text.remove_prefix(start);
+         }
+
+         // stops at the end of the value
+         parser.reset(json::storage_ptr(parsed.arena.get()));
+         text.remove_prefix(parser.write_some(text.data(), text.size()));
+         parsed.lines.push_back(parser.release());
+      }
+      if (chunk.commas && !chunk.table && parsed.lines.empty())
+         throw std::runtime_error("json snapshot table ends with a comma");
+      return parsed;
+   }
+
+   // hands the parsed rows to the visitor, a table ends where the next one begins.
+   // ndjson tables begin with a table line, json tables with the chunk starting their array
+   class ChunkFeeder
+   {
+      const SnapshotVisitor&     m_Visitor;
+      bool                       m_TableLines;
+      std::optional<std::string> m_Table;
+
+      void Begin(std::string tableName)
+      {
+         End();
+         m_Table.emplace(std::move(tableName));
+         m_Visitor.beginTable(*m_Table);
+      }
+
+   public:
+      ChunkFeeder(const SnapshotVisitor& visitor, bool tableLines) :
+         m_Visitor(visitor), m_TableLines(tableLines) {}
+
+      void Feed(const ParsedChunk& chunk)
+      {
+         if (chunk.table)
+            Begin(*chunk.table);
+         for (const auto& line: chunk.lines)
+         {
+            const auto& obj   = line.as_object();
+            auto        table = m_TableLines && obj.size() == 1 ? obj.if_contains(ndjson_table_key) : nullptr;
+            if (table)
+               Begin(std::string(table->as_string()));
+            else if (m_Table)
+               m_Visitor.row(obj);
+            else
+               throw std::runtime_error("ndjson row before the first table line");
+         }
+      }
+
+      void End()
+      {
+         if (m_Table)
+            m_Visitor.endTable(*m_Table);
+         m_Table.reset();
+      }
+   };
+
+   // chunks are parsed a wave of workers chunks at a time, each into its own arena,
+   // the next wave is parsed while the visitor is busy with the rows of the current one
+   void StreamChunks(const std::function<std::optional<TextChunk>()>& next, const SnapshotVisitor& visitor, size_t workers, bool tableLines)
+   {
+      workers        = std::max<size_t>(1, workers);
+      auto parseWave = [&]()
+      {
+         std::vector<TextChunk> chunks;
+         while (chunks.size() < workers)
+         {
+            auto chunk = next();
+            if (!chunk)
+               break;
+            chunks.push_back(std::move(*chunk));
+         }
+         std::vector<ParsedChunk> parsed(chunks.size());
+         ParallelFor(chunks.size(), workers, [&](size_t idx)
+                     { parsed[idx] = ParseChunk(chunks[idx]); });
+         return parsed;
+      };
+
+      ChunkFeeder feeder(visitor, tableLines);
+      auto        pending = std::async(std::launch::async, parseWave);
+      for (;;)
+      {
+         auto wave = pending.get();
+         if (wave.empty())
+            break;
+         pending = std::async(std::launch::async, parseWave);
+         for (const auto& chunk: wave)
+            feeder.Feed(chunk);
+      }
+      feeder.End();
+   }
+
+   // text is the beginning of the input, already read
+   void StreamNdjson(std::istream& input, std::string text, const SnapshotVisitor& visitor, size_t workers)
+   {
+      std::string carry = std::move(text);   // lines not complete yet
+      auto        next  = [&]() -> std::optional<TextChunk>
+      {
+         TextChunk chunk;
+         chunk.owned.swap(carry);
+         while (input)
+         {
+            auto size = chunk.owned.size();
+            chunk.owned.resize(size + snapshot_chunk);
+            input.read(chunk.owned.data() + size, snapshot_chunk);
+            chunk.owned.resize(size + static_cast<size_t>(input.gcount()));
+
+            // the carry has no newline, a line longer than a chunk is read until it ends
+            auto eol = chunk.owned.rfind('\n');
+            if (eol != std::string::npos && input)
+            {
+               carry.assign(chunk.owned, eol + 1);
+               chunk.owned.resize(eol + 1);
+               break;
+            }
+         }
+         if (chunk.owned.empty())
+            return std::nullopt;
+         return chunk;
+      };
+      StreamChunks(next, visitor, workers, true);
+   }
+
+   void StreamNdjson(std::string_view text, const SnapshotVisitor& visitor, size_t workers)
+   {
+      auto next = [&]() -> std::optional<TextChunk>
+      {
+         if (text.empty())
+            return std::nullopt;
+         auto eol = text.size() <= snapshot_chunk ? std::string_view::npos : text.find('\n', snapshot_chunk);
+         auto end = eol == std::string_view::npos ? text.size() : eol + 1;
+
+         TextChunk chunk;
+         chunk.view = text.substr(0, end);
+         text.remove_prefix(end);
+         return chunk;
+      };
+      StreamChunks(next, visitor, workers, true);
+   }
+}   // namespace
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+   // structural scan of a json snapshot: finds the arrays of the TlgSchema tables and cuts them
+   // in chunks of about chunkSize bytes between two rows, the chunks are then parsed in parallel.
+   // only the bytes which can change the structure are looked at: quotes, backslashes, braces,
+   // brackets, commas and colons, found 16 bytes at a time.
+   // the parsers of the chunks validate the rows, the text around them is parsed once the scan is done
+   class RowIndexer
+   {
+      std::string_view                       m_Text;
+      std::vector<TextChunk>                 m_Chunks;
+      std::vector<std::pair<size_t, size_t>> m_Arrays;       // rows of each table, between the brackets
+      size_t                                 m_Depth {};
+      bool                                   m_InString {};
+      size_t                                 m_StringStart {};
+      size_t                                 m_Escaped {};   // position following a backslash in a string
+      std::string_view                       m_String;       // last string, the key when a colon follows
+      std::string_view                       m_Key;          // key of the value being opened at schema or table depth
+      bool                                   m_InSchema {};
+      std::optional<std::string>             m_Table;        // name of the table until its first chunk is cut
+      size_t                                 m_ArrayStart {};
+      size_t                                 m_ChunkStart {};
+      size_t                                 m_ChunkSize;
+
+      void Cut(size_t pos)
+      {
+         TextChunk chunk;
+         chunk.view   = m_Text.substr(m_ChunkStart, pos - m_ChunkStart);
+         chunk.table  = std::exchange(m_Table, std::nullopt);
+         chunk.commas = true;
+         m_Chunks.push_back(std::move(chunk));
+         m_ChunkStart = pos + 1;
+      }
+
+      // false when the snapshot can't be indexed
+      bool Structural(size_t pos)
+      {
+         auto c = m_Text[pos];
+         if (m_InString)
+         {
+            if (pos == m_Escaped)
+               return true;
+            if (c == '\\')
+            {
+               m_Escaped = pos + 1;
+            }
+            else if (c == '"')
+            {
+               m_InString = false;
+               m_String   = m_Text.substr(m_StringStart, pos - m_StringStart);
+            }
+            return true;
+         }
+
+         switch (c)
+         {
+            case '"':
+               m_InString    = true;
+               m_StringStart = pos + 1;
+               break;
+            case ':':
+               m_Key = m_String;
+               break;
+            case '{':
+            case '[':
+               m_Depth++;
+               if (m_Depth == schema_depth && m_Key == delta_key)
+                  return false;   // refused by the streaming parser
+               if (m_Depth == schema_depth)
+                  m_InSchema = c == '{' && m_Key == "TlgSchema";
+               if (m_Depth == table_depth && m_InSchema)
+               {
+                  // structure of array tables and escaped table names are left to the streaming parser
+                  if (c == '{' || m_Key.find('\\') != std::string_view::npos)
+                     return false;
+                  m_Table.emplace(m_Key);
+                  m_ArrayStart = pos + 1;
+                  m_ChunkStart = pos + 1;
+               }
+               break;
+            case '}':
+            case ']':
+               if (m_Depth == table_depth && m_InSchema)
+               {
+                  Cut(pos);
+                  m_Arrays.emplace_back(m_ArrayStart, pos);
+               }
+               if (m_Depth == schema_depth)
+                  m_InSchema = false;
+               if (m_Depth-- == 0)
+                  return false;
+               break;
+            case ',':
+               if (m_Depth == table_depth && m_InSchema && pos - m_ChunkStart >= m_ChunkSize)
+                  Cut(pos);
+               break;
+         }
+         return true;
+      }
+
+      // the document with its table arrays emptied, ex: a missing comma between two tables
+      // or a stray token outside of the rows, which the scan doesn't look at
+      bool ValidOutsideRows() const
+      {
+         json::stream_parser parser;
+         json::error_code    ec;
+         size_t              pos = 0;
+         for (auto [begin, end]: m_Arrays)
+         {
+            parser.write(m_Text.data() + pos, begin - pos, ec);
+            if (ec)
+               return false;
+            pos = end;
+         }
+         parser.write(m_Text.data() + pos, m_Text.size() - pos, ec);
+         if (!ec)
+            parser.finish(ec);
+         return !ec;
+      }
+
+   public:
+      RowIndexer(std::string_view text, size_t chunkSize) :
+         m_Text(text), m_ChunkSize(chunkSize) {}
+
+      std::optional<std::vector<TextChunk>> Scan()
+      {
+         size_t pos = 0;
+#if defined(SNAPSHOT_SSE2)
+         const auto quote     = _mm_set1_epi8('"');
+         const auto backslash = _mm_set1_epi8('\\');
+         const auto comma     = _mm_set1_epi8(',');
+         const auto colon     = _mm_set1_epi8(':');
+         const auto opening   = _mm_set1_epi8('{');   // '[' | 0x20
+         const auto closing   = _mm_set1_epi8('}');   // ']' | 0x20
+         const auto lower     = _mm_set1_epi8(0x20);
+         for (; pos + 16 <= m_Text.size(); pos += 16)
+         {
+            auto bytes   = _mm_loadu_si128(reinterpret_cast<const __m128i*>(m_Text.data() + pos));
+            auto folded  = _mm_or_si128(bytes, lower);
+            auto matches = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(bytes, quote), _mm_cmpeq_epi8(bytes, backslash)),
+                                        _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(bytes, comma), _mm_cmpeq_epi8(bytes, colon)),
+                                                     _mm_or_si128(_mm_cmpeq_epi8(folded, opening), _mm_cmpeq_epi8(folded, closing))));
+            for (auto mask = static_cast<unsigned>(_mm_movemask_epi8(matches)); mask; mask &= mask - 1)
+            {
+               if (!Structural(pos + std::countr_zero(mask)))
+                  return std::nullopt;
+            }
+         }
+#endif
+         for (; pos < m_Text.size(); pos++)
+         {
+            switch (m_Text[pos])
+            {
+               case '"':
+               case '\\':
+               case ',':
+               case ':':
+               case '{':
+               case '}':
+               case '[':
+               case ']':
+                  if (!Structural(pos))
+                     return std::nullopt;
+                  break;
+            }
+         }
+
+         // left to the streaming parser, which reports the error
+         if (m_Depth != 0 || m_InString || !ValidOutsideRows())
+            return std::nullopt;
+         return std::move(m_Chunks);
+      }
+   };
+}   // namespace
+
+bool StreamIndexed(std::string_view text, const SnapshotVisitor& visitor, size_t workers, size_t chunkSize)
+{
+   auto chunks = RowIndexer(text, std::max<size_t>(1, chunkSize)).Scan();
+   if (!chunks)
+      return false;
+
+   size_t chunkIdx = 0;
+   auto   next     = [&]() -> std::optional<TextChunk>
+   {
+      if (chunkIdx == chunks->size())
+         return std::nullopt;
+      return std::move((*chunks)[chunkIdx++]);
+   };
+   StreamChunks(next, visitor, workers, false);
+   return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+Snapshot::Snapshot(const std::string& filename, size_t workers) :
+   Snapshot(MappedFile(filename), workers)
+{
+}
+
+Snapshot::Snapshot(MappedFile file, size_t workers) :
+   m_File(std::move(file))
+{
+   if (IsBinarySnapshot(m_File.View()))
+   {
+      m_Binary.emplace(m_File.View());
+   }
+   else
+   {
+      // ndjson and json tables in the array of rows layout are parsed in parallel,
+      // into the same document json::parse would give
+      json::object    tables;
+      json::array*    rows {};
+      SnapshotVisitor visitor;
+      visitor.beginTable = [&](const std::string& tableName)
+      { rows = &tables[tableName].emplace_array(); };
+      visitor.row = [&](const json::object& row)
+      { rows->emplace_back(row); };
+      visitor.endTable = [](const std::string&) {};
+
+      if (IsNdjsonSnapshot(m_File.View()))
+      {
+         StreamSnapshot(m_File.View(), visitor, workers);
+         m_Json = {{"version", "1.0.0"}, {"TlgSchema", std::move(tables)}};
+      }
+      else if (workers > 1 && StreamIndexed(m_File.View(), visitor, workers))
+      {
+         m_Json = {{"version", "1.0.0"}, {"TlgSchema", std::move(tables)}};
+      }
+      else
+      {
+         m_Json = json::parse(m_File.View());
+         if (m_Json.is_object() && m_Json.get_object().contains(delta_key))
+            throw std::runtime_error(std::string(delta_error));
+      }
+      // the text is not needed anymore
+      m_File.Close();
+   }
+}
+
+bool Snapshot::HasTable(const std::string& tableName) const
+{
+   if (m_Binary)
+      return m_Binary->Find(tableName).has_value();
+   return m_Json.at("TlgSchema").as_object().contains(tableName);
+}
+
+TableRows Snapshot::Table(const std::string& tableName) const
+{
+   if (!m_Binary)
+      return TableRows(m_Json.at("TlgSchema").at(tableName));
+
+   auto table = m_Binary->Find(tableName);
+   if (!table)
+      throw std::runtime_error(std::format("table {} not in snapshot", tableName));
+   return TableRows(std::move(*table));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+DeltaSnapshot::DeltaSnapshot(MappedFile file)
+{
+   m_Json     = json::parse(file.View());
+   auto delta = m_Json.is_object() ? m_Json.get_object().if_contains(delta_key) : nullptr;
+   if (!delta || !delta->is_object())
+      throw std::runtime_error("not a TlgDelta snapshot, it is written by TlgAccess2Json --delta");
+
+   auto isRow = [](const json::value& row)
+   { return row.is_object(); };
+   for (const auto& table: delta->get_object())
+   {
+      std::string_view tableName = table.key();
+      if (!table.value().is_object())
+         throw std::runtime_error(std::format("table {} of the delta is not an object", tableName));
+      for (auto section: delta_sections)
+      {
+         auto rows = table.value().get_object().if_contains(section);
+         if (rows && (!rows->is_array() || !std::ranges::all_of(rows->get_array(), isRow)))
+            throw std::runtime_error(std::format("{} of table {} of the delta is not an array of rows", section, tableName));
+      }
+   }
+}
+
+bool DeltaSnapshot::HasTable(const std::string& tableName) const
+{
+   return m_Json.at(delta_key).as_object().contains(tableName);
+}
+
+// a missing section has no rows
+const json::array& DeltaSnapshot::Section(const std::string& tableName, std::string_view section) const
+{
+   static const json::array none;
+   auto                     rows = m_Json.at(delta_key).at(tableName).as_object().if_contains(section);
+   return rows ? rows->get_array() : none;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool IsNdjsonSnapshot(std::string_view data)
+{
+   return data.starts_with("{\"") && data.substr(2).starts_with(ndjson_table_key) && data.substr(2 + ndjson_table_key.size()).starts_with("\":");
+}
+
+void StreamSnapshot(std::istream& input, const SnapshotVisitor& visitor, size_t workers)
+{
+   std::vector<char> buffer(64 * 1024);
+   input.read(buffer.data(), buffer.size());
+   auto size = static_cast<size_t>(input.gcount());
+   if (IsNdjsonSnapshot(std::string_view(buffer.data(), size)))
+   {
+      StreamNdjson(input, std::string(buffer.data(), size), visitor, workers);
+      return;
+   }
+
+   json::basic_parser<SnapshotHandler> parser(json::parse_options {}, visitor);
+   json::error_code                    ec;
+   while (size)
+   {
+      parser.write_some(true, buffer.data(), size, ec);
+      CheckParser(parser, ec);
+      if (!input)
+         break;
+      input.read(buffer.data(), buffer.size());
+      size = static_cast<size_t>(input.gcount());
+   }
+   if (!parser.done())
+   {
+      parser.write_some(false, buffer.data(), 0, ec);
+      CheckParser(parser, ec);
+   }
+}
+
+void StreamSnapshot(std::string_view text, const SnapshotVisitor& visitor, size_t workers)
+{
+   if (IsNdjsonSnapshot(text))
+   {
+      StreamNdjson(text, visitor, workers);
+      return;
+   }
+   if (workers > 1 && StreamIndexed(text, visitor, workers))
+      return;
+
+   json::basic_parser<SnapshotHandler> parser(json::parse_options {}, visitor);
+   json::error_code                    ec;
+   parser.write_some(false, text.data(), text.size(), ec);
+   CheckParser(parser, ec);
+}
+
+std::vector<std::string> SnapshotTables(std::string_view text, size_t workers)
+{
+   std::vector<std::string> tables;
+   SnapshotVisitor          visitor;
+   visitor.beginTable = [&](const std::string& tableName)
+   { tables.push_back(tableName); };
+   visitor.row      = [](const json::object&) {};
+   visitor.endTable = [](const std::string&) {};
+   StreamSnapshot(text, visitor, workers);
+   return tables;
+}
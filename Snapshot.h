@@ -0,0 +1,127 @@
+#pragma once
+
+#include <functional>
+#include <istream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <boost/json.hpp>
+
+#include "BinarySnapshot.h"
+#include "Columnar.h"
+#include "MappedFile.h"
+
+// rows of a snapshot table, whatever the snapshot layout or format
+class TableRows
+{
+   const boost::json::array*     m_Rows {};
+   std::optional<ColumnarReader> m_Columns;
+   std::optional<BinaryTable>    m_Binary;
+
+public:
+   // a json table is either an array of rows or an object in the structure of array layout
+   explicit TableRows(const boost::json::value& table);
+   explicit TableRows(BinaryTable table) :
+      m_Binary(std::move(table)) {}
+
+   size_t size() const;
+
+   template <typename Fn>
+   void ForEach(Fn&& fn) const
+   {
+      if (m_Rows)
+      {
+         for (const auto& data: *m_Rows)
+            fn(data.as_object());
+      }
+      else if (m_Columns)
+      {
+         for (size_t rowIdx = 0; rowIdx < m_Columns->size(); rowIdx++)
+            fn(m_Columns->Row(rowIdx));
+      }
+      else
+      {
+         for (size_t rowIdx = 0; rowIdx < m_Binary->size(); rowIdx++)
+            fn(m_Binary->Row(rowIdx));
+      }
+   }
+};
+
+// a snapshot file as written by TlgAccess2Json, json, ndjson or binary (not a TlgDelta one, see DeltaSnapshot).
+// binary snapshot are used in place from the mapping, json and ndjson are parsed from it
+// by up to workers threads (see StreamSnapshot)
+class Snapshot
+{
+   MappedFile                          m_File;
+   std::optional<BinarySnapshotReader> m_Binary;
+   boost::json::value                  m_Json;
+
+public:
+   explicit Snapshot(const std::string& filename, size_t workers = 1);   // "-" is stdin
+   explicit Snapshot(MappedFile file, size_t workers = 1);
+
+   Snapshot(const Snapshot&)            = delete;
+   Snapshot& operator=(const Snapshot&) = delete;
+
+   bool      HasTable(const std::string& tableName) const;
+   TableRows Table(const std::string& tableName) const;   // throws if not in snapshot
+};
+
+// changed rows written by TlgAccess2Json --delta, applied by JSon2Access --delta:
+// {"version":"1.0.0","TlgDelta":{"table":{"inserted":[rows],"updated":[rows],"deleted":[key columns]}}}
+// a delta is expected to be small, it is parsed in memory and checked before anything is applied
+class DeltaSnapshot
+{
+   boost::json::value m_Json;
+
+   const boost::json::array& Section(const std::string& tableName, std::string_view section) const;
+
+public:
+   explicit DeltaSnapshot(MappedFile file);
+
+   bool                      HasTable(const std::string& tableName) const;
+   const boost::json::array& Inserted(const std::string& tableName) const { return Section(tableName, "inserted"); }
+   const boost::json::array& Updated(const std::string& tableName) const { return Section(tableName, "updated"); }
+   const boost::json::array& Deleted(const std::string& tableName) const { return Section(tableName, "deleted"); }   // key columns
+};
+
+// callbacks of StreamSnapshot, in the order of the file
+struct SnapshotVisitor
+{
+   std::function<void(const std::string& tableName)>   beginTable;
+   std::function<void(const boost::json::object& row)> row;
+   std::function<void(const std::string& tableName)>   endTable;
+};
+
+// json snapshot read without building its DOM (boost::json::basic_parser).
+// rows of the TlgSchema tables are handed to the visitor as soon as they are parsed,
+// memory is bounded by a row, except for tables in the structure of array layout
+// which have to be built, one table at a time.
+// the rest of the document (version...) is skipped, a TlgDelta snapshot is refused before any table.
+// an ndjson snapshot is recognized from its first line, its lines are parsed by up to workers threads.
+// with workers > 1 a json snapshot in memory is first scanned for the boundaries of the rows of its
+// table arrays, the rows are then parsed in parallel as well (structure of array tables are streamed)
+void StreamSnapshot(std::istream& input, const SnapshotVisitor& visitor, size_t workers = 1);
+void StreamSnapshot(std::string_view text, const SnapshotVisitor& visitor, size_t workers = 1);   // ex: a MappedFile
+
+// bytes of rows parsed by one task
+constexpr size_t snapshot_chunk = 4 << 20;
+
+// json snapshot in memory, as StreamSnapshot does it with workers > 1: a structural scan finds the rows
+// of the table arrays and cuts them in chunks of about chunkSize bytes, parsed by up to workers threads.
+// false when the snapshot can't be indexed (structure of array tables, malformed outside of the rows...),
+// nothing was visited then
+bool StreamIndexed(std::string_view text, const SnapshotVisitor& visitor, size_t workers, size_t chunkSize = snapshot_chunk);
+
+// names of the tables of a json or ndjson snapshot in memory, its rows are parsed and dropped:
+// a malformed or truncated snapshot throws before anything is imported from it
+std::vector<std::string> SnapshotTables(std::string_view text, size_t workers = 1);
+
+// ndjson snapshot: a {"TlgTable":"name"} line before the rows of each table, then one compact row per line.
+// it can be cut at any line: the text is split in chunks of whole lines parsed in parallel,
+// the rows are still handed to the visitor in order, on the calling thread
+constexpr std::string_view ndjson_table_key = "TlgTable";
+
+bool IsNdjsonSnapshot(std::string_view data);
@@ -0,0 +1,240 @@
+/* Copyright(c) Jada Informatique 2021.
+
+Jada Informatique Software License - Version 1.0 - june 27th, 2021
+
+Permission is hereby granted, free of charge, to any person or organization
+obtaining a copy of the software and accompanying documentation covered by
+this license (the "Software") to use, reproduce, display, distribute,
+execute, and transmit the Software, and to prepare derivative works of the
+Software, and to permit third-parties to whom the Software is furnished to
+do so, all subject to the following:
+
+The copyright notices in the Software and this entire statement, including
+the above license grant, this restriction and the following disclaimer,
+must be included in all copies of the Software, in whole or in part, and
+all derivative works of the Software, unless such copies or derivative
+works are solely in the form of machine-executable object code generated by
+a source language processor.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+// checks the structural index of json snapshots (StreamIndexed, see Snapshot.h) against json::parse:
+// escaped keys and strings, nested arrays, structural characters in strings, at every chunk boundary
+// of small documents then on generated ones. malformed tables must be refused at any boundary
+
+#include <format>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <boost/json.hpp>
+
+#include "CmdLine.h"
+#include "Snapshot.h"
+
+namespace json = boost::json;
+
+namespace
+{
+   // hand written documents, the tricky parts of the scan
+   const std::vector<std::string> documents = {
+      R"({"version":"1.0.0","TlgSchema":{"Tags":[]}})",
+      R"({"version":"1.0.0","TlgSchema":{"Tags":[{"a":1},{"b":2}],"Fields":[ {"c":"x"} , {"d":null} ]}})",
+      // escaped quotes and backslashes in keys and strings, structural characters in strings
+      R"({"TlgSchema":{"Tags":[{"k\"ey":"v\\","x\\\"":"\"[{,:}]\""},{"":"\\\\","u":"\u00e9\u005b\u0022,"}]}})",
+      // nested arrays and objects in rows
+      R"({"TlgSchema":{"Tags":[{"a":[1,[2,[3,[]]],{"b":[{},{"c":[]}]}]},{"a":[[],[[]]]}]}})",
+      // members around the schema, a TlgSchema key deeper down is not the schema
+      R"({"meta":{"TlgSchema":{"No":[{"a":1}]}},"list":[[1,2],{"x":[3]}],"TlgSchema":{"Tags":[{"a":1}]},"after":[{"b":2}]})",
+      // escaped table name and structure of array table, left to the basic_parser
+      R"({"TlgSchema":{"T\u0061gs":[{"a":1}],"Cols":{"recordCount":2,"data":{"a":[1,2],"b":["x","y"]}}}})",
+      // blanks everywhere
+      "{ \"TlgSchema\" : {\r\n \"Tags\" : [\r\n {\"a\" : 1}\r\n ,\t{\"a\":2} \r\n ] } }\r\n",
+   };
+
+   const std::vector<std::string> malformed = {
+      R"({"TlgSchema":{"Tags":[{"a":1},,{"a":2}]}})",
+      R"({"TlgSchema":{"Tags":[{"a":1} {"a":2}]}})",
+      R"({"TlgSchema":{"Tags":[{"a":1},]}})",
+      R"({"TlgSchema":{"Tags":[,{"a":1}]}})",
+      R"({"TlgSchema":{"Tags":[{"a":1},{"a":2}],"Fields":[{"a":1}]})",
+      R"({"TlgSchema":{"Tags":[{"a":1},{"a":"2}]}})",
+      R"({"TlgSchema":{"Tags":[{"a":1},2]}})",
+      // outside of the rows
+      R"({"TlgSchema":{"Tags":[{"a":1}] "Fields":[{"a":1}]}})",
+      R"({"TlgSchema":{"Tags":[{"a":1}] x,"Fields":[]}})",
+      R"({"TlgSchema":{"Tags":[{"a":1}],}})",
+      R"({"version" "1.0.0","TlgSchema":{"Tags":[{"a":1}]}})",
+      R"({"version":"1.0.0" "TlgSchema":{"Tags":[{"a":1}]}})",
+      R"({"TlgSchema":{"Tags":[{"a":1}]]})",
+   };
+
+   // tables as json::parse reads them, structure of array ones as rows
+   json::object Parsed(std::string_view text)
+   {
+      json::object tables;
+      auto         document = json::parse(text);
+      if (auto schema = document.as_object().if_contains("TlgSchema"))
+      {
+         for (const auto& table: schema->as_object())
+         {
+            auto& rows = tables[table.key()].emplace_array();
+            TableRows(table.value()).ForEach([&](const json::object& row)
+                                             { rows.emplace_back(row); });
+         }
+      }
+      return tables;
+   }
+
+   // tables as the visitor gets them, from the basic_parser when the snapshot can't be indexed
+   json::object Streamed(std::string_view text, size_t workers, size_t chunkSize)
+   {
+      json::object    tables;
+      json::array*    rows {};
+      SnapshotVisitor visitor;
+      visitor.beginTable = [&](const std::string& tableName)
+      { rows = &tables[tableName].emplace_array(); };
+      visitor.row = [&](const json::object& row)
+      { rows->emplace_back(row); };
+      visitor.endTable = [](const std::string&) {};
+      if (!StreamIndexed(text, visitor, workers, chunkSize))
+         StreamSnapshot(text, visitor);
+      return tables;
+   }
+
+   // strings full of the characters the scan looks at
+   json::value MakeValue(std::mt19937& gen, size_t depth)
+   {
+      static constexpr std::string_view alphabet = "ab \"\\{}[],:\n\t/\xc3\xa9";
+      std::uniform_int_distribution<int> kind(0, depth < 3 ? 5 : 3);
+      std::uniform_int_distribution<int> length(0, 12);
+      std::uniform_int_distribution<int> letter(0, static_cast<int>(alphabet.size()) - 2);   // é is 2 bytes
+
+      auto makeString = [&]()
+      {
+         std::string str;
+         for (auto count = length(gen); count > 0; count--)
+         {
+            auto idx = letter(gen);
+            str += alphabet[idx] == '\xc3' ? std::string_view("\xc3\xa9") : alphabet.substr(idx, 1);
+         }
+         return str;
+      };
+
+      switch (kind(gen))
+      {
+         case 0:
+            return nullptr;
+         case 1:
+            return std::int64_t(gen()) - 0x7fffffff;
+         case 2:
+         case 3:
+            return json::string(makeString());
+         case 4:
+         {
+            json::array array;
+            for (auto count = length(gen) / 3; count > 0; count--)
+               array.push_back(MakeValue(gen, depth + 1));
+            return array;
+         }
+         default:
+         {
+            json::object object;
+            for (auto count = length(gen) / 3; count > 0; count--)
+               object[makeString()] = MakeValue(gen, depth + 1);
+            return object;
+         }
+      }
+   }
+
+   std::string MakeDocument(std::mt19937& gen, size_t rows)
+   {
+      json::object schema;
+      for (auto tableName: {"Tags", "Fields", "LogFiles"})
+      {
+         auto& table = schema[tableName].emplace_array();
+         for (size_t row = 0; row < rows; row++)
+         {
+            json::object obj;
+            obj["Code"] = row;
+            for (int col = 0; col < 4; col++)
+               obj[std::format("c{}", col)] = MakeValue(gen, 1);
+            table.push_back(std::move(obj));
+         }
+      }
+      return json::serialize(json::object {{"version", "1.0.0"}, {"TlgSchema", std::move(schema)}});
+   }
+}   // namespace
+
+int main(int argc, char** argv)
+{
+   try
+   {
+      CmdLine cmdLine(argc, argv);
+      auto    workers = cmdLine.GetSize("workers", 4);
+      size_t  failures {0};
+      auto    check   = [&](const std::string& name, std::string_view text, size_t chunkSize)
+      {
+         auto expected = Parsed(text);
+         for (size_t threads: {size_t {1}, workers})
+         {
+            if (Streamed(text, threads, chunkSize) != expected)
+            {
+               std::cerr << std::format("{}: tables differ, chunks of {} bytes, {} worker(s)", name, chunkSize, threads) << std::endl;
+               failures++;
+            }
+         }
+      };
+
+      // every boundary of the small documents
+      for (size_t doc = 0; doc < documents.size(); doc++)
+      {
+         for (size_t chunkSize = 1; chunkSize <= documents[doc].size(); chunkSize++)
+            check(std::format("document {}", doc), documents[doc], chunkSize);
+      }
+      for (size_t doc = 0; doc < malformed.size(); doc++)
+      {
+         for (size_t chunkSize = 1; chunkSize <= malformed[doc].size(); chunkSize++)
+         {
+            try
+            {
+               Streamed(malformed[doc], workers, chunkSize);
+               std::cerr << std::format("malformed document {} accepted, chunks of {} bytes", doc, chunkSize) << std::endl;
+               failures++;
+            }
+            catch (const std::exception&)
+            {
+            }
+         }
+      }
+
+      std::mt19937 gen(static_cast<std::mt19937::result_type>(cmdLine.GetSize("seed", 2021)));
+      for (size_t doc = 0, count = cmdLine.GetSize("documents", 20); doc < count; doc++)
+      {
+         auto text = MakeDocument(gen, cmdLine.GetSize("rows", 200));
+         for (size_t chunkSize: {size_t {1}, size_t {100}, size_t {4096}, snapshot_chunk})
+            check(std::format("generated document {}", doc), text, chunkSize);
+      }
+
+      if (failures)
+      {
+         std::cerr << std::format("{} check(s) failed", failures) << std::endl;
+         return 2;
+      }
+      std::cout << "structural index matches json::parse" << std::endl;
+   }
+   catch (const std::exception& e)
+   {
+      std::cerr << e.what() << '\n';
+      return 1;
+   }
+   return 0;
+}
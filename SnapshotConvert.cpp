@@ -0,0 +1,178 @@
+/* Copyright(c) Jada Informatique 2021.
+
+Jada Informatique Software License - Version 1.0 - june 27th, 2021
+
+Permission is hereby granted, free of charge, to any person or organization
+obtaining a copy of the software and accompanying documentation covered by
+this license (the "Software") to use, reproduce, display, distribute,
+execute, and transmit the Software, and to prepare derivative works of the
+Software, and to permit third-parties to whom the Software is furnished to
+do so, all subject to the following:
+
+The copyright notices in the Software and this entire statement, including
+the above license grant, this restriction and the following disclaimer,
+must be included in all copies of the Software, in whole or in part, and
+all derivative works of the Software, unless such copies or derivative
+works are solely in the form of machine-executable object code generated by
+a source language processor.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+// converts a snapshot between the json and the binary formats,
+// with --verify a json to binary conversion is read back and compared row by row
+
+#include <format>
+#include <fstream>
+#include <iostream>
+
+#include <boost/json.hpp>
+
+#include "BinarySnapshot.h"
+#include "CmdLine.h"
+#include "Columnar.h"
+#include "MappedFile.h"
+#include "PrettyPrint.h"
+
+namespace json = boost::json;
+
+void BinaryToJson(std::string_view snapshot, const std::string& output, bool columns)
+{
+   BinarySnapshotReader reader(snapshot);
+   json::object         tables;
+   for (size_t idx = 0; idx < reader.Tables(); idx++)
+   {
+      auto table     = reader.Table(idx);
+      auto tableName = json::string_view(table.Name().data(), table.Name().size());
+      if (columns)
+      {
+         tables[tableName] = table.ToColumnar();
+      }
+      else
+      {
+         json::array rows;
+         rows.reserve(table.size());
+         for (size_t row = 0; row < table.size(); row++)
+            rows.push_back(table.Row(row));
+         tables[tableName] = std::move(rows);
+      }
+   }
+
+   json::object jsonDoc;
+   jsonDoc["version"]   = "1.0.0";
+   jsonDoc["TlgSchema"] = std::move(tables);
+
+   std::ofstream fileOut(output);
+   pretty_print(fileOut, jsonDoc);
+}
+
+// count rows of the binary snapshot which are not the same as the json ones
+size_t Verify(const json::object& jsonTables, const std::string& output)
+{
+   MappedFile           snapshot(output);
+   BinarySnapshotReader reader(snapshot.View());
+   size_t               mismatches {0};
+   for (const auto& jsonTable: jsonTables)
+   {
+      auto tableName = std::string_view(jsonTable.key().data(), jsonTable.key().size());
+      auto table     = reader.Find(tableName);
+      if (!table)
+      {
+         std::cerr << std::format("table {} missing", tableName) << std::endl;
+         mismatches++;
+         continue;
+      }
+
+      auto rowCount = jsonTable.value().is_object() ? jsonTable.value().at("recordCount").to_number<size_t>() : jsonTable.value().as_array().size();
+      if (rowCount != table->size())
+      {
+         std::cerr << std::format("table {} has {} row(s), expected {}", tableName, table->size(), rowCount) << std::endl;
+         mismatches++;
+      }
+
+      auto compare = [&](size_t rowIdx, const json::object& row)
+      {
+         if (table->Row(rowIdx) != row)
+         {
+            std::cerr << std::format("table {} row {} differs: {}", tableName, rowIdx, json::serialize(row)) << std::endl;
+            mismatches++;
+         }
+      };
+
+      if (jsonTable.value().is_object())
+      {
+         ColumnarReader columns(jsonTable.value().get_object());
+         for (size_t rowIdx = 0; rowIdx < columns.size() && rowIdx < table->size(); rowIdx++)
+            compare(rowIdx, columns.Row(rowIdx));
+      }
+      else
+      {
+         const auto& rows = jsonTable.value().as_array();
+         for (size_t rowIdx = 0; rowIdx < rows.size() && rowIdx < table->size(); rowIdx++)
+            compare(rowIdx, rows[rowIdx].as_object());
+      }
+   }
+   return mismatches;
+}
+
+size_t JsonToBinary(MappedFile snapshot, const std::string& output, bool verify)
+{
+   auto jsonDoc = json::parse(snapshot.View());
+   snapshot.Close();   // the text is not needed anymore
+   const auto& jsonTables = jsonDoc.at("TlgSchema").as_object();
+   {
+      std::ofstream        fileOut(output, std::ios::binary);
+      BinarySnapshotWriter writer(fileOut, static_cast<std::uint32_t>(jsonTables.size()));
+      for (const auto& table: jsonTables)
+      {
+         auto tableName = std::string_view(table.key().data(), table.key().size());
+         if (table.value().is_object())
+            writer.AddTable(tableName, table.value().get_object());
+         else
+            writer.AddTable(tableName, RowsToColumns(table.value().as_array()));
+      }
+      writer.Close();
+   }
+   return verify ? Verify(jsonTables, output) : 0;
+}
+
+int main(int argc, char** argv)
+{
+   try
+   {
+      CmdLine cmdLine(argc, argv);
+      if (cmdLine.Positional().size() != 2)
+      {
+         std::cerr << "usage: SnapshotConvert input output [--layout=rows|columns] [--verify]" << std::endl;
+         std::cerr << "       json input is converted to binary, binary input to json" << std::endl;
+         return 1;
+      }
+
+      MappedFile snapshot(cmdLine.Positional()[0]);
+      if (IsBinarySnapshot(snapshot.View()))
+      {
+         BinaryToJson(snapshot.View(), cmdLine.Positional()[1], cmdLine.Get("layout", "rows") == "columns");
+      }
+      else
+      {
+         auto mismatches = JsonToBinary(std::move(snapshot), cmdLine.Positional()[1], cmdLine.Has("verify"));
+         if (mismatches)
+         {
+            std::cerr << std::format("{} difference(s) found", mismatches) << std::endl;
+            return 2;
+         }
+      }
+   }
+   catch (const std::exception& e)
+   {
+      std::cerr << e.what() << '\n';
+      return 1;
+   }
+   return 0;
+}
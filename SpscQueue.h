@@ -0,0 +1,71 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+// bounded queue between one producer thread and one consumer thread: a ring of slots
+// and two counters, no lock. only a full queue blocks the producer and an empty one the consumer,
+// they then wait on the counter of the other side (std::atomic::wait).
+// the time spent blocked is added to stalled, when given
+template <typename T>
+class SpscQueue
+{
+   std::vector<T>                  m_Slots;
+   alignas(64) std::atomic<size_t> m_Head {};   // slots popped, written by the consumer
+   alignas(64) std::atomic<size_t> m_Tail {};   // slots pushed, written by the producer
+
+   // wait until counter is not value anymore
+   static size_t WaitChange(const std::atomic<size_t>& counter, size_t value, std::chrono::nanoseconds* stalled)
+   {
+      auto start = std::chrono::steady_clock::now();
+      counter.wait(value, std::memory_order_acquire);
+      if (stalled)
+         *stalled += std::chrono::steady_clock::now() - start;
+      return counter.load(std::memory_order_acquire);
+   }
+
+public:
+   explicit SpscQueue(size_t capacity) :
+      m_Slots(std::max<size_t>(1, capacity)) {}
+
+   SpscQueue(const SpscQueue&)            = delete;
+   SpscQueue& operator=(const SpscQueue&) = delete;
+
+   void Push(T value, std::chrono::nanoseconds* stalled = nullptr)
+   {
+      auto tail = m_Tail.load(std::memory_order_relaxed);
+      auto head = m_Head.load(std::memory_order_acquire);
+      while (tail - head == m_Slots.size())
+         head = WaitChange(m_Head, head, stalled);
+
+      m_Slots[tail % m_Slots.size()] = std::move(value);
+      m_Tail.store(tail + 1, std::memory_order_release);
+      m_Tail.notify_one();
+   }
+
+   T Pop(std::chrono::nanoseconds* stalled = nullptr)
+   {
+      auto head = m_Head.load(std::memory_order_relaxed);
+      auto tail = m_Tail.load(std::memory_order_acquire);
+      while (head == tail)
+         tail = WaitChange(m_Tail, tail, stalled);
+
+      T value = std::move(m_Slots[head % m_Slots.size()]);
+      m_Head.store(head + 1, std::memory_order_release);
+      m_Head.notify_one();
+      return value;
+   }
+
+   // nothing when the queue is empty
+   std::optional<T> TryPop()
+   {
+      auto head = m_Head.load(std::memory_order_relaxed);
+      if (head == m_Tail.load(std::memory_order_acquire))
+         return std::nullopt;
+      return Pop();
+   }
+};
@@ -0,0 +1,174 @@
+#include "TableGraph.h"
+
+#include <algorithm>
+#include <cctype>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+#include "Platform.h"
+#include "utf8Conversion.h"
+
+TableGraph::TableGraph(std::vector<std::string> tables) :
+   m_Tables(std::move(tables)), m_Parents(m_Tables.size())
+{
+}
+
+std::optional<TableGraph> TableGraph::FromCatalog(nanodbc::connection& conn, std::vector<std::string> tables)
+{
+   TableGraph graph(std::move(tables));
+   for (size_t table = 0; table < graph.size(); table++)
+   {
+      nanodbc::statement stmt(conn);
+      auto               hstmt = stmt.native_statement_handle();
+
+      // table names are ascii
+      const auto&                 tableName = graph.Name(table);
+      std::basic_string<SQLWCHAR> name(tableName.begin(), tableName.end());
+      auto                        rc = SQLForeignKeysW(hstmt, nullptr, 0, nullptr, 0, nullptr, 0, nullptr, 0, nullptr, 0, name.data(), SQL_NTS);
+      if (!SQL_SUCCEEDED(rc))
+         return std::nullopt;   // ex: the access driver does not implement it
+
+      // one row per column of each foreign key of the table, PKTABLE_NAME is the third column
+      while (SQL_SUCCEEDED(SQLFetch(hstmt)))
+      {
+         SQLWCHAR pkTable[256] {};
+         SQLLEN   length {};
+         if (!SQL_SUCCEEDED(SQLGetData(hstmt, 3, SQL_C_WCHAR, pkTable, sizeof(pkTable), &length)) || length <= 0)
+            continue;
+         std::string parentName;
+         AppendUtf16ToUtf8(std::u16string_view(reinterpret_cast<const char16_t*>(pkTable)), parentName);
+         if (auto parent = graph.Find(parentName); parent && *parent != table)
+            graph.AddDependency(table, *parent);
+      }
+   }
+   return graph;
+}
+
+TableGraph TableGraph::FromForeignKeys(std::vector<std::string> tables, const std::vector<std::pair<size_t, size_t>>& foreignKeys)
+{
+   TableGraph graph(std::move(tables));
+   for (auto [table, parent]: foreignKeys)
+      graph.AddDependency(table, parent);
+   return graph;
+}
+
+void TableGraph::AddDependency(size_t table, size_t parent)
+{
+   auto& parents = m_Parents.at(table);
+   if (parent >= size())
+      throw std::out_of_range("TableGraph::AddDependency");
+   if (std::ranges::find(parents, parent) == parents.end())
+      parents.push_back(parent);
+}
+
+std::optional<size_t> TableGraph::Find(std::string_view tableName) const
+{
+   auto sameName = [&](const std::string& name)
+   {
+      return std::ranges::equal(name, tableName, [](char a, char b)
+                                { return std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b)); });
+   };
+   auto it = std::ranges::find_if(m_Tables, sameName);
+   if (it == m_Tables.end())
+      return std::nullopt;
+   return static_cast<size_t>(it - m_Tables.begin());
+}
+
+std::vector<std::vector<size_t>> TableGraph::Children() const
+{
+   std::vector<std::vector<size_t>> children(size());
+   for (size_t table = 0; table < size(); table++)
+      for (auto parent: m_Parents[table])
+         children[parent].push_back(table);
+   return children;
+}
+
+void TableGraph::Run(size_t workers, bool reversed, const std::function<void(size_t)>& fn) const
+{
+   auto        children = Children();
+   const auto& waitFor  = reversed ? children : m_Parents;
+   const auto& unblocks = reversed ? m_Parents : children;
+
+   // tables become ready in the order of the graph when nothing else decides
+   std::vector<size_t> pending(size());
+   std::deque<size_t>  ready;
+   for (size_t table = 0; table < size(); table++)
+   {
+      pending[table] = waitFor[table].size();
+      if (!pending[table])
+         ready.push_back(table);
+   }
+
+   // a cycle would leave tables waiting forever
+   {
+      auto                waiting = pending;
+      std::vector<size_t> order(ready.begin(), ready.end());
+      for (size_t idx = 0; idx < order.size(); idx++)
+         for (auto next: unblocks[order[idx]])
+            if (!--waiting[next])
+               order.push_back(next);
+      if (order.size() != size())
+         throw std::runtime_error("the foreign keys between the tables have a cycle");
+   }
+
+   std::mutex              mutex;
+   std::condition_variable changed;
+   size_t                  running {0};
+   std::exception_ptr      error;
+
+   auto worker = [&]()
+   {
+      std::unique_lock lock(mutex);
+      for (;;)
+      {
+         changed.wait(lock, [&] { return !ready.empty() || error || running == 0; });
+         if (error || ready.empty())
+            return;
+
+         auto table = ready.front();
+         ready.pop_front();
+         running++;
+         lock.unlock();
+
+         std::exception_ptr failure;
+         try
+         {
+            fn(table);
+         }
+         catch (...)
+         {
+            failure = std::current_exception();
+         }
+
+         lock.lock();
+         running--;
+         if (failure)
+         {
+            if (!error)
+               error = failure;
+         }
+         else
+         {
+            for (auto next: unblocks[table])
+               if (!--pending[next])
+                  ready.push_back(next);
+         }
+         changed.notify_all();
+      }
+   };
+
+   {
+      workers = std::clamp<size_t>(workers, 1, std::max<size_t>(size(), 1));
+      std::vector<std::jthread> threads;
+      for (size_t i = 1; i < workers; i++)
+         threads.emplace_back(worker);
+      worker();
+   }
+
+   if (error)
+      std::rethrow_exception(error);
+}
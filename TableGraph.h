@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <nanodbc/nanodbc.h>
+
+// tables of an import and the foreign keys between them.
+// a table can be filled once the tables it references are committed,
+// and emptied once the tables referencing it are
+class TableGraph
+{
+   std::vector<std::string>         m_Tables;
+   std::vector<std::vector<size_t>> m_Parents;   // tables referenced by each table
+
+public:
+   explicit TableGraph(std::vector<std::string> tables);
+
+   // from the foreign keys of the catalog (SQLForeignKeys), nullopt when the driver can't tell
+   static std::optional<TableGraph> FromCatalog(nanodbc::connection& conn, std::vector<std::string> tables);
+   // from known foreign keys, {table, referenced table} indexes in tables
+   static TableGraph FromForeignKeys(std::vector<std::string> tables, const std::vector<std::pair<size_t, size_t>>& foreignKeys);
+
+   void AddDependency(size_t table, size_t parent);
+
+   size_t                           size() const { return m_Tables.size(); }
+   const std::string&               Name(size_t table) const { return m_Tables.at(table); }
+   std::optional<size_t>            Find(std::string_view tableName) const;   // names are not case sensitive
+   const std::vector<size_t>&       Parents(size_t table) const { return m_Parents.at(table); }
+   std::vector<std::vector<size_t>> Children() const;
+
+   // fn(table) for every table on up to workers threads, the calling thread included.
+   // a table is started once its parents are done (its children when reversed, ex: to delete).
+   // the first exception stops starting new tables and is rethrown once the running ones are done.
+   // throws when the dependencies have a cycle
+   void Run(size_t workers, bool reversed, const std::function<void(size_t)>& fn) const;
+};
@@ -0,0 +1,167 @@
+/* Copyright(c) Jada Informatique 2021.
+
+Jada Informatique Software License - Version 1.0 - june 27th, 2021
+
+Permission is hereby granted, free of charge, to any person or organization
+obtaining a copy of the software and accompanying documentation covered by
+this license (the "Software") to use, reproduce, display, distribute,
+execute, and transmit the Software, and to prepare derivative works of the
+Software, and to permit third-parties to whom the Software is furnished to
+do so, all subject to the following:
+
+The copyright notices in the Software and this entire statement, including
+the above license grant, this restriction and the following disclaimer,
+must be included in all copies of the Software, in whole or in part, and
+all derivative works of the Software, unless such copies or derivative
+works are solely in the form of machine-executable object code generated by
+a source language processor.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+*/
+
+// times the code page 1252 <-> utf-8 and utf-16 -> utf-8 transcoders on generated text,
+// on windows against the previous locale + wstring_convert implementation
+
+#include <chrono>
+#include <codecvt>
+#include <format>
+#include <iostream>
+#include <locale>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "CmdLine.h"
+#include "utf8Conversion.h"
+
+namespace
+{
+#if defined(_WIN32)
+   std::locale                                      loc1252(".1252");
+   std::wstring_convert<std::codecvt_utf8<wchar_t>> wconv;
+
+   std::u8string LocaleCp1252ToUtf8(const std::string& cp1252Str)
+   {
+      std::wstring wstr(cp1252Str.size(), L'\0');
+      std::use_facet<std::ctype<wchar_t>>(loc1252).widen(cp1252Str.data(), cp1252Str.data() + cp1252Str.size(), wstr.data());
+      auto narrow = wconv.to_bytes(wstr);
+      return std::u8string(narrow.cbegin(), narrow.cend());
+   }
+
+   std::string LocaleUtf8ToCp1252(const std::u8string& utf8str)
+   {
+      auto           wstr = wconv.from_bytes(std::string {utf8str.cbegin(), utf8str.cend()});
+      auto&          f    = std::use_facet<std::codecvt<wchar_t, char, std::mbstate_t>>(loc1252);
+      std::mbstate_t mb {};
+      std::string    cp1252Str(wstr.size() * f.max_length(), '\0');
+      const wchar_t* fromNext {};
+      char*          toNext {};
+      f.out(mb, wstr.data(), wstr.data() + wstr.size(), fromNext, cp1252Str.data(), cp1252Str.data() + cp1252Str.size(), toNext);
+      cp1252Str.resize(toNext - cp1252Str.data());
+      return cp1252Str;
+   }
+#endif
+
+   // cells of a typical table, mostly ascii with some accented letters
+   std::vector<std::string> MakeCells(size_t count, size_t percentHigh)
+   {
+      std::mt19937                       gen(1252);
+      std::uniform_int_distribution<int> length(4, 64);
+      std::uniform_int_distribution<int> percent(0, 99);
+      std::uniform_int_distribution<int> ascii(0x20, 0x7e);
+      std::uniform_int_distribution<int> high(0xa0, 0xff);
+
+      std::vector<std::string> cells(count);
+      for (auto& cell: cells)
+      {
+         cell.resize(length(gen));
+         for (auto& c: cell)
+            c = static_cast<char>(static_cast<size_t>(percent(gen)) < percentHigh ? high(gen) : ascii(gen));
+      }
+      return cells;
+   }
+
+   template<typename Fn>
+   void Time(const char* name, size_t bytes, Fn&& fn)
+   {
+      auto start   = std::chrono::steady_clock::now();
+      fn();
+      auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      std::cout << std::format("{:<22} {:8.3f}s  {:8.1f} MB/s", name, seconds, seconds > 0 ? bytes / (1024.0 * 1024.0) / seconds : 0.0) << std::endl;
+   }
+}   // namespace
+
+int main(int argc, char** argv)
+{
+   try
+   {
+      CmdLine cmdLine(argc, argv);
+      auto    cells = MakeCells(cmdLine.GetSize("cells", 1000000), cmdLine.GetSize("accents", 5));
+      size_t  bytes {0};
+      for (const auto& cell: cells)
+         bytes += cell.size();
+
+      std::vector<std::u8string> utf8Cells(cells.size());
+      Time("cp1252 -> utf8", bytes, [&]
+           {
+              for (size_t idx = 0; idx < cells.size(); idx++)
+                 utf8Cells[idx] = Cp1252ToUtf8(cells[idx]);
+           });
+
+      size_t mismatches {0};
+      Time("utf8 -> cp1252", bytes, [&]
+           {
+              for (size_t idx = 0; idx < cells.size(); idx++)
+                 mismatches += Utf8ToCp1252(utf8Cells[idx]) != cells[idx];
+           });
+
+      // generated cells are ascii or latin-1, code points are the code page bytes
+      std::vector<std::u16string> utf16Cells(cells.size());
+      for (size_t idx = 0; idx < cells.size(); idx++)
+      {
+         for (auto c: cells[idx])
+            utf16Cells[idx] += static_cast<char16_t>(static_cast<unsigned char>(c));
+      }
+      Time("utf16 -> utf8", bytes * 2, [&]
+           {
+              std::string utf8;
+              for (size_t idx = 0; idx < cells.size(); idx++)
+              {
+                 utf8.clear();
+                 AppendUtf16ToUtf8(utf16Cells[idx], utf8);
+                 mismatches += utf8.size() != utf8Cells[idx].size();
+              }
+           });
+
+#if defined(_WIN32)
+      Time("locale cp1252 -> utf8", bytes, [&]
+           {
+              for (size_t idx = 0; idx < cells.size(); idx++)
+                 mismatches += LocaleCp1252ToUtf8(cells[idx]) != utf8Cells[idx];
+           });
+      Time("locale utf8 -> cp1252", bytes, [&]
+           {
+              for (size_t idx = 0; idx < cells.size(); idx++)
+                 mismatches += LocaleUtf8ToCp1252(utf8Cells[idx]) != cells[idx];
+           });
+#endif
+
+      if (mismatches)
+      {
+         std::cerr << std::format("{} cell(s) did not round trip", mismatches) << std::endl;
+         return 2;
+      }
+   }
+   catch (const std::exception& e)
+   {
+      std::cerr << e.what() << '\n';
+      return 1;
+   }
+   return 0;
+}
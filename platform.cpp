@@ -1,7 +1,6 @@
 #include <windows.h>
 
 #include <cstdio>
-#include <locale>
 
 class SwitchConsoleToUtf8
 {
@@ -22,14 +21,3 @@ public:
 };
 
 static SwitchConsoleToUtf8 ToUtf8;
-
-std::locale&
-   GetConsoleLoc()
-{
-   // the console is using codepage defined at:
-   // HKEY_LOCAL_MACHINE\SYSTEM\CurrentControlSet\Control\Nls\CodePage\OEMCP
-   // which happens to be 850 in North America
-
-   static std::locale locConsole(".850");
-   return locConsole;
-}
@@ -1,73 +1,263 @@
 #include "utf8Conversion.h"
 
-#include <codecvt>
-#include <locale>
+#include <bit>
+#include <cstdint>
+#include <cstring>
 #include <string>
-#include <vector>
 
-#include <windows.h>
+#include "CodePage.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+   #include <emmintrin.h>
+   #define UTF8_CONVERSION_SSE2
+#endif
+
+// length of the leading pure ascii run, which is copied as is both ways
+size_t AsciiPrefix(const char* p, const char* end)
+{
+   const char* start = p;
+#if defined(UTF8_CONVERSION_SSE2)
+   while (end - p >= 16)
+   {
+      // high bit set on any byte means non ascii
+      if (auto mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)))))
+         return (p - start) + std::countr_zero(mask);
+      p += 16;
+   }
+#endif
+   while (p < end && static_cast<unsigned char>(*p) < 0x80)
+      p++;
+   return p - start;
+}
+
+// decode one utf-8 sequence, invalid ones are consumed one byte at a time and give U+FFFD
+char32_t DecodeUtf8(const char*& p, const char* end)
+{
+   constexpr char32_t invalid = 0xfffd;
+
+   auto lead = static_cast<unsigned char>(*p++);
+   if (lead < 0x80)
+      return lead;
+
+   int      count;
+   char32_t cp;
+   if (lead >= 0xc2 && lead < 0xe0)
+   {
+      count = 1;
+      cp    = lead & 0x1f;
+   }
+   else if (lead >= 0xe0 && lead < 0xf0)
+   {
+      count = 2;
+      cp    = lead & 0x0f;
+   }
+   else if (lead >= 0xf0 && lead < 0xf5)
+   {
+      count = 3;
+      cp    = lead & 0x07;
+   }
+   else
+   {
+      return invalid;
+   }
+
+   if (end - p < count)
+      return invalid;
+   for (int idx = 0; idx < count; idx++)
+   {
+      auto next = static_cast<unsigned char>(p[idx]);
+      if ((next & 0xc0) != 0x80)
+         return invalid;
+      cp = (cp << 6) | (next & 0x3f);
+   }
+   // overlong, surrogate or out of range
+   if ((count == 2 && cp < 0x800) || (count == 3 && (cp < 0x10000 || cp > 0x10ffff)) || (cp >= 0xd800 && cp < 0xe000))
+      return invalid;
+   p += count;
+   return cp;
+}
 
 namespace
 {
-   // access is using this code page
-   std::locale loc1252(".1252");
+   // utf-8 encoding of a code point, returns the number of bytes written (1 to 4)
+   size_t EncodeUtf8(char32_t cp, char* out)
+   {
+      if (cp < 0x80)
+      {
+         out[0] = static_cast<char>(cp);
+         return 1;
+      }
+      if (cp < 0x800)
+      {
+         out[0] = static_cast<char>(0xc0 | (cp >> 6));
+         out[1] = static_cast<char>(0x80 | (cp & 0x3f));
+         return 2;
+      }
+      if (cp < 0x10000)
+      {
+         out[0] = static_cast<char>(0xe0 | (cp >> 12));
+         out[1] = static_cast<char>(0x80 | ((cp >> 6) & 0x3f));
+         out[2] = static_cast<char>(0x80 | (cp & 0x3f));
+         return 3;
+      }
+      out[0] = static_cast<char>(0xf0 | (cp >> 18));
+      out[1] = static_cast<char>(0x80 | ((cp >> 12) & 0x3f));
+      out[2] = static_cast<char>(0x80 | ((cp >> 6) & 0x3f));
+      out[3] = static_cast<char>(0x80 | (cp & 0x3f));
+      return 4;
+   }
+
+   bool IsHighSurrogate(char16_t c) { return c >= 0xd800 && c < 0xdc00; }
+   bool IsLowSurrogate(char16_t c) { return c >= 0xdc00 && c < 0xe000; }
 
-   std::wstring_convert<std::codecvt_utf8<wchar_t>> myconv;
+   // length of the leading ascii run of utf-16 text, narrowed to out as it is scanned
+   size_t AsciiPrefix(const char16_t* p, const char16_t* end, char* out)
+   {
+      const char16_t* start = p;
+#if defined(UTF8_CONVERSION_SSE2)
+      while (end - p >= 16)
+      {
+         // a unit is ascii when none of its bits above the 7th are set
+         const __m128i nonAsciiBits = _mm_set1_epi16(static_cast<short>(0xff80));
+         __m128i       low          = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+         __m128i       high         = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 8));
+         __m128i       ascii        = _mm_packs_epi16(_mm_cmpeq_epi16(_mm_and_si128(low, nonAsciiBits), _mm_setzero_si128()),
+                                                      _mm_cmpeq_epi16(_mm_and_si128(high, nonAsciiBits), _mm_setzero_si128()));
+         _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_packus_epi16(low, high));
+         if (auto mask = static_cast<unsigned>(~_mm_movemask_epi8(ascii) & 0xffff))
+            return (p - start) + std::countr_zero(mask);
+         p += 16;
+         out += 16;
+      }
+#endif
+      while (p < end && *p < 0x80)
+         *out++ = static_cast<char>(*p++);
+      return p - start;
+   }
 }   // namespace
 
+// unpaired surrogates are replaced by U+FFFD
+TranscodeResult Utf16ToUtf8(std::u16string_view utf16Str, char* out)
+{
+   TranscodeResult result;
+   const char16_t* p     = utf16Str.data();
+   const char16_t* end   = p + utf16Str.size();
+   char*           start = out;
+   while (p < end)
+   {
+      // the ascii run is already narrowed into out, bytes past it are overwritten below
+      auto ascii = AsciiPrefix(p, end, out);
+      out += ascii;
+      p += ascii;
+      if (p == end)
+         break;
+
+      char32_t cp = *p++;
+      if (IsHighSurrogate(static_cast<char16_t>(cp)) && p < end && IsLowSurrogate(*p))
+      {
+         cp = 0x10000 + ((cp - 0xd800) << 10) + (*p++ - 0xdc00);
+      }
+      else if (IsHighSurrogate(static_cast<char16_t>(cp)) || IsLowSurrogate(static_cast<char16_t>(cp)))
+      {
+         cp = 0xfffd;
+         result.unmappable++;
+      }
+      out += EncodeUtf8(cp, out);
+   }
+   result.written = out - start;
+   return result;
+}
+
+TranscodeResult AppendUtf16ToUtf8(std::u16string_view utf16Str, std::string& out)
+{
+   auto size = out.size();
+   out.resize(size + MaxUtf16ToUtf8Size(utf16Str.size()));
+   auto result = Utf16ToUtf8(utf16Str, out.data() + size);
+   out.resize(size + result.written);
+   return result;
+}
+
+// wchar_t is utf-16 on windows, utf-32 elsewhere
 std::wstring Utf8ToWString(const std::u8string& str)
 {
-   return myconv.from_bytes(std::string {str.cbegin(), str.cend()});
+   const char*  p   = reinterpret_cast<const char*>(str.data());
+   const char*  end = p + str.size();
+   std::wstring wstr;
+   wstr.reserve(str.size());
+   while (p < end)
+   {
+      auto cp = DecodeUtf8(p, end);
+      if (sizeof(wchar_t) == 2 && cp >= 0x10000)
+      {
+         wstr += static_cast<wchar_t>(0xd800 + ((cp - 0x10000) >> 10));
+         wstr += static_cast<wchar_t>(0xdc00 + ((cp - 0x10000) & 0x3ff));
+      }
+      else
+      {
+         wstr += static_cast<wchar_t>(cp);
+      }
+   }
+   return wstr;
 }
 
 // convert wstring to UTF-8 string
 std::u8string WStringToUtf8(const std::wstring& wstr)
 {
-   auto narrow = myconv.to_bytes(wstr);
-   return std::u8string(narrow.cbegin(), narrow.cend());
+   std::string utf8;
+   if constexpr (sizeof(wchar_t) == sizeof(char16_t))
+   {
+      AppendUtf16ToUtf8(std::u16string_view(reinterpret_cast<const char16_t*>(wstr.data()), wstr.size()), utf8);
+   }
+   else
+   {
+      utf8.resize(wstr.size() * 4);
+      size_t size {0};
+      for (auto c: wstr)
+      {
+         auto cp = static_cast<char32_t>(c);
+         size += EncodeUtf8(cp > 0x10ffff || (cp >= 0xd800 && cp < 0xe000) ? 0xfffd : cp, utf8.data() + size);
+      }
+      utf8.resize(size);
+   }
+   return std::u8string(utf8.cbegin(), utf8.cend());
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-std::string Utf8ToCp1252(const std::u8string& utf8str)
+TranscodeResult Utf8ToCp1252(std::string_view utf8Str, char* out)
 {
-   // convert to wide string!
-   auto wstr = Utf8ToWString(utf8str);
-
-   auto& f = std::use_facet<std::codecvt<wchar_t, char, std::mbstate_t>>(loc1252);
+   return CodePage::Cp1252().FromUtf8(utf8Str, out);
+}
 
-   std::mbstate_t mb {};
-   std::string    cp1252Str(wstr.size() * f.max_length(), '\0');
-   const wchar_t* fromNext {};
-   char*          toNext {};
-   f.out(mb, &wstr[0], &wstr[wstr.size()], fromNext, &cp1252Str[0], &cp1252Str[cp1252Str.size()], toNext);
-   // error checking skipped for brevity
-   cp1252Str.resize(toNext - &cp1252Str[0]);
+TranscodeResult AppendUtf8ToCp1252(std::string_view utf8Str, std::string& out)
+{
+   return CodePage::Cp1252().AppendFromUtf8(utf8Str, out);
+}
 
+std::string Utf8ToCp1252(const std::u8string& utf8str)
+{
+   std::string cp1252Str;
+   AppendUtf8ToCp1252(std::string_view(reinterpret_cast<const char*>(utf8str.data()), utf8str.size()), cp1252Str);
    return cp1252Str;
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-std::u8string Cp1252ToUtf8(const std::string& cp1252Str)
+TranscodeResult Cp1252ToUtf8(std::string_view cp1252Str, char* out)
 {
-   std::wstring wstr(cp1252Str.size(), L'\0');
-   use_facet<std::ctype<wchar_t>>(loc1252).widen(&cp1252Str[0], &cp1252Str[cp1252Str.size()], &wstr[0]);
-
-   auto result = WStringToUtf8(wstr);
-   return result;
+   return CodePage::Cp1252().ToUtf8(cp1252Str, out);
 }
 
-std::string Utf8ToLocale(const char8_t* utf8str, const std::locale& loc)
+TranscodeResult AppendCp1252ToUtf8(std::string_view cp1252Str, std::string& out)
 {
-   // UTF-8 to wstring
-   std::wstring_convert<std::codecvt_utf8<wchar_t>> wconv;
+   return CodePage::Cp1252().AppendToUtf8(cp1252Str, out);
+}
 
-   std::wstring wstr = wconv.from_bytes(reinterpret_cast<const char*>(utf8str));
-   // wstring to string
-   std::vector<char> buf(wstr.size());
-   use_facet<std::ctype<wchar_t>>(loc).narrow(wstr.data(), wstr.data() + wstr.size(), '?', buf.data());
-   return std::string(buf.data(), buf.size());
+std::u8string Cp1252ToUtf8(const std::string& cp1252Str)
+{
+   std::u8string result(MaxCp1252ToUtf8Size(cp1252Str.size()), u8'\0');
+   result.resize(Cp1252ToUtf8(cp1252Str, reinterpret_cast<char*>(result.data())).written);
+   return result;
 }
 
 std::string from_u8string(const std::string& s)
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <cstddef>
 #include <string>
+#include <string_view>
 
 // dealing with wide string in database
 std::wstring  Utf8ToWString(const std::u8string& str);
@@ -10,6 +12,34 @@ std::u8string WStringToUtf8(const std::wstring& str);
 std::string   Utf8ToCp1252(const std::u8string& utf8str);
 std::u8string Cp1252ToUtf8(const std::string& cp1252Str);
 
+// allocation free versions, thread safe, they write into a caller buffer or append to a reused string.
+// unmappable characters (and invalid utf-8) are replaced by '?' and counted
+struct TranscodeResult
+{
+   size_t written {};      // bytes written to the output
+   size_t unmappable {};   // characters replaced
+};
+
+// output buffer size needed for an input of size bytes, see CodePage for other code pages
+constexpr size_t MaxCp1252ToUtf8Size(size_t size) { return size * 3; }
+constexpr size_t MaxUtf8ToCp1252Size(size_t size) { return size; }
+
+TranscodeResult Cp1252ToUtf8(std::string_view cp1252Str, char* out);
+TranscodeResult Utf8ToCp1252(std::string_view utf8Str, char* out);
+
+TranscodeResult AppendCp1252ToUtf8(std::string_view cp1252Str, std::string& out);
+TranscodeResult AppendUtf8ToCp1252(std::string_view utf8Str, std::string& out);
+
+// utf-16 as returned by odbc for SQL_WCHAR columns (SQLWCHAR), whatever the size of wchar_t
+constexpr size_t MaxUtf16ToUtf8Size(size_t size) { return size * 3; }
+
+TranscodeResult Utf16ToUtf8(std::u16string_view utf16Str, char* out);
+TranscodeResult AppendUtf16ToUtf8(std::u16string_view utf16Str, std::string& out);
+
+// building blocks of the transcoders
+size_t   AsciiPrefix(const char* p, const char* end);   // length of the leading ascii run
+char32_t DecodeUtf8(const char*& p, const char* end);   // one sequence, invalid bytes give U+FFFD one at a time
+
 // see: http://www.open-std.org/jtc1/sc22/wg21/docs/papers/2019/p1423r2.html
 // until utf8 is widely supported!!
 std::string from_u8string(const std::string& s);